@@ -104,6 +104,7 @@ licensing and training services.
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 
 #include "lcd.h"
 #include "i2c.h"
@@ -113,11 +114,23 @@ licensing and training services.
 
 #include "stdio.h" 
 #include "dev_misc.h"
+#include "run_time.h"
+#include "mem_pool.h"
+#include "status_push.h"
+#include "serial.h"
 #include "print.h"
 #include "sci2.h"
 
+/* Motion first: the planner keeps the stepper's block buffer fed, the grbl
+   task parses what the receive interrupt stored. Both block when they have
+   nothing to do (queue, serial_wait(), full buffers), only then does the
+   network get the CPU, and the LCD comes last. Nothing below grbl can hold
+   up the g-code stream for longer than a mutex on the serial port. */
+#define planner_TASK_PRIORITY		( tskIDLE_PRIORITY + 4)
+#define grbl_TASK_PRIORITY		( tskIDLE_PRIORITY + 3)
+#define uIP_TASK_PRIORITY		( tskIDLE_PRIORITY + 2)
+#define status_push_TASK_PRIORITY	( tskIDLE_PRIORITY + 2)
 #define temperature_TASK_PRIORITY	( tskIDLE_PRIORITY + 1)
-#define grbl_TASK_PRIORITY		( tskIDLE_PRIORITY + 1)
 
 /*
  * vApplicationMallocFailedHook() will only be called if
@@ -132,6 +145,8 @@ void vApplicationMallocFailedHook( void );
 xTaskHandle grbl_handle;
 extern int grbl_main();
 extern void vuIP_Task(void*);
+extern void planner_task(void*);
+extern void planner_queue_init();
 /*
  * vApplicationStackOverflowHook() will only be called if
  * configCHECK_FOR_STACK_OVERFLOW is set to a non-zero value.  The handle and
@@ -201,12 +216,70 @@ void delay_us(double time_us)
 
 }
 
+uint32_t dev_timestamp()
+{
+	return run_time_ticks();
+}
+
+bool dev_memory_headroom(uint32_t *stack_free, uint32_t *heap_free)
+{
+	task_stack_t stacks[RUN_TIME_TASKS_MAX];
+	int i, count;
+
+	count = run_time_stacks(stacks);
+	*stack_free = UINT32_MAX;
+	for (i = 0; i < count; i++) {
+		if (stacks[i].free_min < *stack_free) {
+			*stack_free = stacks[i].free_min;
+		}
+	}
+	*heap_free = mem_pool_min_free();
+	return count > 0;
+}
+
+/* The grbl and planner tasks wait in sleep_mode() for the stepper interrupt
+   to finish a block or stop (stepper_synchronize(), a full block buffer, the
+   end of a hold) and the grbl task for the planner to take a command off its
+   queue. Both give sleep_signal, so a waiting task runs as soon as there is
+   something to look at. It is a binary semaphore and two tasks can wait at the
+   same time, the other one then waits for the next event or at most a tick. */
+static xSemaphoreHandle sleep_signal;
+
+// block until the stepper or the planner make progress, at most a tick
 void sleep_mode()
 {
+	xSemaphoreTake(sleep_signal, 1);
+}
+
+void sleep_mode_wake()
+{
+	xSemaphoreGive(sleep_signal);
+}
+
+void sleep_mode_wake_from_isr()
+{
+	long woken = pdFALSE;
 
+	xSemaphoreGiveFromISR(sleep_signal, &woken);
+	portYIELD_FROM_ISR(woken);
 }
 
-void serial_poll_task(void *);
+#if TASK_STACKS + 1 > RUN_TIME_TASKS_MAX
+#error run_time.c cannot hold the tasks of mem_pool.h and the idle task.
+#endif
+
+// xTaskCreate() and hand the task to run_time.c for the stack high-water marks
+static void create_task(pdTASK_CODE code, const char *name, unsigned short stack_depth,
+		unsigned portBASE_TYPE priority, xTaskHandle *handle)
+{
+	xTaskHandle created = NULL;
+
+	xTaskCreate(code, ( signed char * ) name, stack_depth, NULL, priority, &created);
+	run_time_add_task(created, name, stack_depth);
+	if (handle != NULL) {
+		*handle = created;
+	}
+}
 
 int main(void) {
 	HardwareSetup();
@@ -222,14 +295,19 @@ int main(void) {
 	//adc_init();
 
 	sci2_init();
+	serial_init();
 
 	printString("GRBL started\n");	
 
+	vSemaphoreCreateBinary(sleep_signal);
+	planner_queue_init();
+
 	// Application Tasks
-	xTaskCreate(serial_poll_task, ( signed char * ) "serial", configMINIMAL_STACK_SIZE*1, NULL, grbl_TASK_PRIORITY, &grbl_handle);
-	xTaskCreate(grbl_task, ( signed char * ) "grbl", configMINIMAL_STACK_SIZE*7, NULL, grbl_TASK_PRIORITY, &grbl_handle);
-	xTaskCreate(temp_accel_task, ( signed char * ) "temp-accel", configMINIMAL_STACK_SIZE*2, NULL, temperature_TASK_PRIORITY, NULL );
-	xTaskCreate(vuIP_Task, ( signed char * ) "uIP", configMINIMAL_STACK_SIZE*5, NULL, grbl_TASK_PRIORITY, NULL );
+	create_task(grbl_task, "grbl", configMINIMAL_STACK_SIZE*GRBL_STACK, grbl_TASK_PRIORITY, &grbl_handle);
+	create_task(planner_task, "planner", configMINIMAL_STACK_SIZE*PLANNER_STACK, planner_TASK_PRIORITY, NULL);
+	create_task(temp_accel_task, "temp-accel", configMINIMAL_STACK_SIZE*TEMP_ACCEL_STACK, temperature_TASK_PRIORITY, NULL);
+	create_task(status_push_task, "status", configMINIMAL_STACK_SIZE*STATUS_STACK, status_push_TASK_PRIORITY, NULL);
+	create_task(vuIP_Task, "uIP", configMINIMAL_STACK_SIZE*UIP_STACK, uIP_TASK_PRIORITY, NULL);
 	
 	/* Start the tasks running. */
 	vTaskStartScheduler();
@@ -311,6 +389,8 @@ void temp_accel_task(void *pvParameters)
 		sprintf(str,"temp = %f",(double)temp);
 		lcd_string(LCD_LINE5, 0, str);
 
+		run_time_sample();
+
 		vTaskDelayUntil( &xLastWakeTime, xFrequency ); // Wait for the next cycle.
 	}
 }
@@ -329,7 +409,11 @@ void vApplicationMallocFailedHook( void )
    of this file. */
 void vApplicationStackOverflowHook( xTaskHandle *pxTask, signed char *pcTaskName )
 {
-	debug("overflow");
+	char str[24];
+
+	// the name is in the TCB, which sits below the stack and is normally intact
+	snprintf(str, sizeof(str), "overflow %s", (char *) pcTaskName);
+	debug(str);
 	for( ;; );
 }
 /*-----------------------------------------------------------*/
@@ -2,6 +2,8 @@
 #define ARCH_MISC_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
 
 #define PSTR	 /**/ 
 
@@ -15,6 +17,29 @@ void dev_disable_ints();
 void delay_ms(double time_ms);
 void delay_us(double time_us);
 void sleep_mode();
+void sleep_mode_wake();           // from a task
+void sleep_mode_wake_from_isr();  // from an interrupt at or below the syscall priority
 void led_toggle();
 
+// CMT3 free running at PCLK/8, the same as RUN_TIME_TICKS_HZ, see run_time.c
+uint32_t dev_timestamp();
+#define DEV_TIMESTAMP_HZ (PCLK_FREQUENCY/8)
+
+// smallest stack headroom of any task and the lowest free heap so far, in
+// bytes, false where there is nothing to measure
+bool dev_memory_headroom(uint32_t *stack_free, uint32_t *heap_free);
+
+// interrupts off and back to how they were, for a few instructions
+static inline uint32_t dev_irq_save()
+{
+	uint32_t psw;
+	__asm volatile ("mvfc psw, %0\n\tclrpsw i" : "=r" (psw) : : "memory");
+	return psw;
+}
+
+static inline void dev_irq_restore(uint32_t psw)
+{
+	__asm volatile ("mvtc %0, psw" : : "r" (psw) : "memory");
+}
+
 #endif
@@ -0,0 +1,316 @@
+/*
+  dev_stepper.c - the rx62n side of stepper.c: step timer, coils and their timing
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+/* CMT2 is the step timer, counting at PCLK/512 and cleared on its compare
+   match. Its interrupt pulses the steps stepper.c worked out one period
+   before and lets it work out the next. The motors are driven directly
+   through their coils, a full step per step event. */
+
+#include "dev_misc.h"
+#include "board.h"
+
+#include "iodefine.h"
+
+#include "stepper.h"
+#include "planner.h"
+#include "config.h"
+
+#include "FreeRTOS.h"
+#include "run_time.h"
+
+#define STEPPER_X_A1	LED5
+#define STEPPER_X_A2	LED6	
+#define STEPPER_X_B1	LED7	
+#define STEPPER_X_B2	LED8	
+
+#define STEPPER_Y_A1 	LED1	
+#define STEPPER_Y_A2 	LED2	
+#define STEPPER_Y_B1 	LED3
+#define STEPPER_Y_B2 	LED4
+
+#define STEPPER_Z_A1 	LED9
+#define STEPPER_Z_A2 	LED10
+#define STEPPER_Z_B1 	LED11
+#define STEPPER_Z_B2 	LED12
+
+//#define STEPPER_X_ENABLE LED12
+//#define STEPPER_Y_ENABLE LED13
+
+#define STEPPER_ALL_PINS STEPPER_X_A1 = STEPPER_X_A2 = STEPPER_X_B1=STEPPER_X_B2=STEPPER_Y_A1=STEPPER_Y_A2=STEPPER_Y_B1=STEPPER_Y_B2=STEPPER_Z_A1=STEPPER_Z_A2=STEPPER_Z_B1=STEPPER_Z_B2//=STEPPER_X_ENABLE=STEPPER_Y_ENABLE
+
+#define STEPPER_PORT 	0
+
+#define DIR_FORWARD	1
+#define DIR_BACKWARD	0
+
+// Both timings are taken from run_time_ticks(), CMT3 free running at PCLK/8 (see
+// run_time.c). CMT2 clears on its compare match, so each match comes a known
+// number of these ticks after the one before; the latency is how much later
+// stepper_handler() starts than its match was due.
+#define TICKS_PER_CMT2_COUNT (512/8)
+#define TICKS_TO_NS(ticks) (((uint32_t)(ticks)*1000UL)/(PCLK_FREQUENCY/8000000UL))
+
+static uint32_t last_match;    // run_time_ticks() at the compare match that started the period
+static uint32_t period_ticks;  // the period running now, in run_time_ticks()
+
+void do_full_step(int direction, int axis);
+void do_half_step(int direction, int axis);
+
+
+void dev_stepper_init()
+{
+  // Configure directions of interface pins
+  	//GPIO_SetDirection(STEPPER_PORT, 0, STEPPER_ALL_PINS);
+	STEPPER_ALL_PINS=0;//GPIO_Write(STEPPER_PORT,0, STEPPER_ALL_PINS); //clear all
+
+	MSTP( CMT2 ) = 0;
+
+	/* Interrupt on compare match. */
+	CMT2.CMCR.BIT.CMIE = 1;
+
+	/* Set the compare match value. */
+	CMT2.CMCOR = ( unsigned short ) (PCLK_FREQUENCY/512)*2;
+
+	/* Divide the PCLK by 512. */
+	CMT2.CMCR.BIT.CKS = 3;
+
+	/* Enable the interrupt... */
+	_IEN( _CMT2_CMI2 ) = 1;
+
+	_IPR( _CMT2_CMI2 ) = 1;
+
+	/* Start the timers. */
+	CMT.CMSTR1.BIT.STR2 = 1;
+	last_match = run_time_ticks();
+	period_ticks = (CMT2.CMCOR + 1) * TICKS_PER_CMT2_COUNT;
+}
+
+// Reload CMT2's compare match. The running period ends at the new value, or after
+// the counter wrapped when it is past that already.
+void dev_stepper_period(uint32_t steps_per_minute)
+{
+	uint16_t counts = ((F_CPU/512)*60)/steps_per_minute;
+	uint32_t psw = dev_irq_save();
+	CMT2.CMCOR = counts;
+	period_ticks = (counts + 1) * TICKS_PER_CMT2_COUNT;
+	if (CMT2.CMCNT > counts) {
+		period_ticks += 0x10000UL * TICKS_PER_CMT2_COUNT;
+	}
+	dev_irq_restore(psw);
+}
+
+void stepper_handler( void ) __attribute__((interrupt));
+void stepper_handler()
+{
+	uint32_t entry = run_time_ticks();
+	uint32_t latency;
+	uint8_t queued;
+
+	// keep track of the matches while idle too, the timer never stops
+	last_match += period_ticks;
+	latency = entry - last_match;
+	if (latency > 0x10000UL * TICKS_PER_CMT2_COUNT) {  // lost track, start over
+		last_match = entry;
+		latency = 0;
+	}
+	period_ticks = (CMT2.CMCOR + 1) * TICKS_PER_CMT2_COUNT;  // unless dev_stepper_period() changes it
+
+	if(!do_int)
+		return;
+
+	queued = planner_blocks_queued();
+	stepper_interrupt();
+	if (planner_blocks_queued() != queued || !do_int) {  // room in the buffer or stopped
+		sleep_mode_wake_from_isr();
+	}
+	stepper_record_isr_timing(TICKS_TO_NS(run_time_ticks() - entry), TICKS_TO_NS(latency));
+}
+
+void dev_stepper_pulse(uint8_t out_bits)
+{
+	led_toggle();
+
+	if(out_bits & (1<<X_STEP_BIT)) {
+		if(out_bits & (1<<X_DIRECTION_BIT)) {
+//			do_half_step(DIR_BACKWARD, X_AXIS);
+			do_full_step(DIR_BACKWARD, X_AXIS);
+		} else {
+			//do_half_step(DIR_FORWARD, X_AXIS);
+			do_full_step(DIR_FORWARD, X_AXIS);
+		}
+	}	
+	if(out_bits & (1<<Y_STEP_BIT)) {
+		if(out_bits & (1<<Y_DIRECTION_BIT)) {
+//			do_half_step(DIR_FORWARD, Y_AXIS);
+			do_full_step(DIR_FORWARD, Y_AXIS);
+		} else {
+	//		do_half_step(DIR_BACKWARD, Y_AXIS);
+			do_full_step(DIR_BACKWARD, Y_AXIS);
+		}	
+	}
+	if(out_bits & (1<<Z_STEP_BIT)) {
+		if(out_bits & (1<<Z_DIRECTION_BIT)) {
+//			do_half_step(DIR_FORWARD, Z_AXIS);
+			do_full_step(DIR_FORWARD, Z_AXIS);
+		} else {
+//			do_half_step(DIR_BACKWARD, Z_AXIS);
+			do_full_step(DIR_BACKWARD, Z_AXIS);
+		}	
+	}
+}
+
+//pointers to bitfields dont exist.. thus we use functions...
+void set_STEPPER_X_A1(int val) { STEPPER_X_A1 = val;}
+void set_STEPPER_X_A2(int val) { STEPPER_X_A2 = val;}
+void set_STEPPER_X_B1(int val) { STEPPER_X_B1 = val;}
+void set_STEPPER_X_B2(int val) { STEPPER_X_B2 = val;}
+
+void set_STEPPER_Y_A1(int val) { STEPPER_Y_A1 = val;}
+void set_STEPPER_Y_A2(int val) { STEPPER_Y_A2 = val;}
+void set_STEPPER_Y_B1(int val) { STEPPER_Y_B1 = val;}
+void set_STEPPER_Y_B2(int val) { STEPPER_Y_B2 = val;}
+
+void set_STEPPER_Z_A1(int val) { STEPPER_Z_A1 = val;}
+void set_STEPPER_Z_A2(int val) { STEPPER_Z_A2 = val;}
+void set_STEPPER_Z_B1(int val) { STEPPER_Z_B1 = val;}
+void set_STEPPER_Z_B2(int val) { STEPPER_Z_B2 = val;}
+
+void (*stepper_pins[3][4]) (int val) = {
+		{set_STEPPER_X_A1, set_STEPPER_X_A2, set_STEPPER_X_B1, set_STEPPER_X_B2},
+		{set_STEPPER_Y_A1, set_STEPPER_Y_A2, set_STEPPER_Y_B1, set_STEPPER_Y_B2},
+		{set_STEPPER_Z_A1, set_STEPPER_Z_A2, set_STEPPER_Z_B1, set_STEPPER_Z_B2},
+		};
+
+void do_half_step(int direction, int axis) 
+{
+	static int crrnt_step[3] = {0,0,0};
+
+	
+	if(direction == DIR_FORWARD) {
+		crrnt_step[axis] ++;
+		if (crrnt_step[axis] >= 8)
+			crrnt_step[axis] = 0;
+	}
+	else{
+		if(crrnt_step[axis] == 0)
+			crrnt_step[axis] = 8;
+		crrnt_step[axis] --;			
+	}
+	
+	switch(crrnt_step[axis]) {
+		case 7:
+			stepper_pins[axis][1](0);
+			stepper_pins[axis][3](0);
+			stepper_pins[axis][0](1);
+			stepper_pins[axis][2](1);
+			break;	
+		case 6:
+			stepper_pins[axis][1](0);
+			stepper_pins[axis][3](0);
+			stepper_pins[axis][0](1);
+			stepper_pins[axis][2](0);
+			break;
+		case 5:
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][0] | stepper_pins[axis][3], stepper_pins[axis][1] | stepper_pins[axis][2]);
+			stepper_pins[axis][0](1);
+			stepper_pins[axis][3](1);
+			stepper_pins[axis][1](0);
+			stepper_pins[axis][2](0);
+			break;	
+		case 4:
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][0] | stepper_pins[axis][3], stepper_pins[axis][1] | stepper_pins[axis][2]);
+			stepper_pins[axis][0](0);
+			stepper_pins[axis][3](1);
+			stepper_pins[axis][1](0);
+			stepper_pins[axis][2](0);
+			break;
+		case 3:	
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][2] | stepper_pins[axis][0], stepper_pins[axis][1] | stepper_pins[axis][3]);
+			stepper_pins[axis][0](0);
+			stepper_pins[axis][2](0);
+			stepper_pins[axis][1](1);
+			stepper_pins[axis][3](1);
+			break;	
+		case 2:	
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][2] | stepper_pins[axis][0], stepper_pins[axis][1] | stepper_pins[axis][3]);
+			stepper_pins[axis][0](0);
+			stepper_pins[axis][2](0);
+			stepper_pins[axis][1](1);
+			stepper_pins[axis][3](0);
+			break;
+		case 1:	
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][2], stepper_pins[axis][0] | stepper_pins[axis][3]);
+			stepper_pins[axis][1](1);
+			stepper_pins[axis][2](1);
+			stepper_pins[axis][0](0);
+			stepper_pins[axis][3](0);
+			break;	
+		case 0:	
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][2], stepper_pins[axis][0] | stepper_pins[axis][3]);
+			stepper_pins[axis][1](0);
+			stepper_pins[axis][2](1);
+			stepper_pins[axis][0](0);
+			stepper_pins[axis][3](0);
+			break;
+	}
+}
+
+void do_full_step(int direction, int axis) 
+{
+	static unsigned int crrnt_step[3] = {0,0,0};
+	
+	if(direction == DIR_FORWARD) {
+		crrnt_step[axis] ++;
+		if (crrnt_step[axis] >= 4)
+			crrnt_step[axis] = 0;
+	}
+	else{
+		if(crrnt_step[axis] == 0)
+			crrnt_step[axis] = 4;
+		crrnt_step[axis] --;			
+	}
+	
+	switch(crrnt_step[axis]) {
+		case 0:
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][3], stepper_pins[axis][0] | stepper_pins[axis][2]);
+			stepper_pins[axis][1](1);
+			stepper_pins[axis][3](1);
+			stepper_pins[axis][0](0);
+			stepper_pins[axis][2](0);
+			break;
+		case 1:
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][0] | stepper_pins[axis][3], stepper_pins[axis][1] | stepper_pins[axis][2]);
+			stepper_pins[axis][0](1);
+			stepper_pins[axis][3](1);
+			stepper_pins[axis][1](0);
+			stepper_pins[axis][2](0);
+			break;
+		case 2:	
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][2] | stepper_pins[axis][0], stepper_pins[axis][1] | stepper_pins[axis][3]);
+			stepper_pins[axis][0](1);
+			stepper_pins[axis][2](1);
+			stepper_pins[axis][1](0);
+			stepper_pins[axis][3](0);
+			break;
+		case 3:	
+		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][2], stepper_pins[axis][0] | stepper_pins[axis][3]);
+			stepper_pins[axis][1](1);
+			stepper_pins[axis][2](1);
+			stepper_pins[axis][0](0);
+			stepper_pins[axis][3](0);
+			break;
+	}
+}
+
@@ -76,14 +76,13 @@
 #define configPERIPHERAL_CLOCK_HZ		( PCLK_FREQUENCY ) /* Set in rskrx62ndef.h. */
 #define configTICK_RATE_HZ			( ( portTickType ) 1000 )
 #define configMINIMAL_STACK_SIZE		( ( unsigned short ) 140 )
-#define configTOTAL_HEAP_SIZE			( ( size_t ) ( 45 * 1024 ) )
 #define configMAX_TASK_NAME_LEN			( 12 )
 #define configUSE_TRACE_FACILITY		1
 #define configUSE_16_BIT_TICKS			0
 #define configIDLE_SHOULD_YIELD			1
 #define configUSE_CO_ROUTINES 			0
 #define configUSE_MUTEXES			1
-#define configGENERATE_RUN_TIME_STATS		0  //just implement: "volatile unsigned long ulHighFrequencyTickCount" in a timer
+#define configGENERATE_RUN_TIME_STATS		1  // time base in run_time.c
 #define configCHECK_FOR_STACK_OVERFLOW		2
 #define configUSE_RECURSIVE_MUTEXES		1
 #define configQUEUE_REGISTRY_SIZE		0
@@ -115,9 +114,10 @@ to exclude the API function. */
 #define INCLUDE_uxTaskGetStackHighWaterMark	1
 #define INCLUDE_xTaskGetSchedulerState		1
 
-extern volatile unsigned long ulHighFrequencyTickCount; // removed it11
-#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() portNOP() /* Run time stats use the same timer as the high frequency timer test. */
-#define portGET_RUN_TIME_COUNTER_VALUE() ulHighFrequencyTickCount
+extern void run_time_timer_init(void);
+extern unsigned long run_time_counter(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() run_time_timer_init() /* CMT3 at PCLK/8 and its overflows, see run_time.c */
+#define portGET_RUN_TIME_COUNTER_VALUE() run_time_counter()
 
 
 /* Override some of the priorities set in the common demo tasks.  This is
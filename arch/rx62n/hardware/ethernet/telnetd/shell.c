@@ -47,9 +47,18 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include "stepper.h"
+#include "run_time.h"
+#include "trace.h"
+#include "status_push.h"
+#include "mem_pool.h"
+#include "config.h"
+
 extern void start_grbl_task();
 extern xTaskHandle grbl_handle;
 extern void serial_receive(char*str);
+extern void gcode_request_feed_override(int percent);
+extern uint8_t gcode_get_feed_override();
 extern FATFS Fatfs;
 
 struct ptentry {
@@ -104,6 +113,15 @@ static void help(char *str)
     shell_output("stats      - show network statistics", "");
     shell_output("grbl       - start grbl", "");
     shell_output("reset_grbl - reset the grbl task", "");
+    shell_output("feed [pct] - show or set override", "");
+    shell_output("isr [reset]- stepper interrupt timing", "");
+    shell_output("push [hz]  - status frames/s, 0 off", "");
+    shell_output("ps         - list the tasks", "");
+    shell_output("top        - CPU usage per task", "");
+    shell_output("mem        - memory pool usage", "");
+    shell_output("stack      - stack high-water marks", "");
+    shell_output("trace [more]- dump the event ring,", "");
+    shell_output("             records again after 30 s", "");
     shell_output("help, ?    - show help", "");
     shell_output("exit       - exit shell", "");
 }
@@ -278,6 +296,103 @@ static void ps(char *str)
 	shell_send_str(tmp);
 }
 
+static void mem(char *str)
+{
+    mem_pool_stats_t stats;
+    int i;
+
+    shell_printf("block  used/all max spilled\n");
+    for (i = 0; i < mem_pool_count(); i++)
+    {
+	mem_pool_stats(i, &stats);
+	shell_printf("%5u %4u/%-3u %3u %u\n", (unsigned) stats.block_size, stats.used, stats.blocks,
+		     stats.max_used, stats.spilled);
+    }
+    shell_printf("%u failed\n", mem_pool_failures());
+}
+
+static void stack(char *str)
+{
+    task_stack_t stacks[RUN_TIME_TASKS_MAX];
+    int i, n;
+
+    n = run_time_stacks(stacks);
+    shell_printf("task         bytes  free free%%\n");
+    for (i = 0; i < n; i++)
+    {
+	shell_printf("%-12s %5u %5u %4u%%\n", stacks[i].name, stacks[i].size, stacks[i].free_min,
+		     100 * stacks[i].free_min / stacks[i].size);
+    }
+    shell_printf("heap %u free, %u at least\n", (unsigned) xPortGetFreeHeapSize(),
+		 (unsigned) mem_pool_min_free());
+}
+
+static void top(char *str)
+{
+    task_usage_t usage[RUN_TIME_TASKS_MAX];
+    int i, n, seconds;
+
+    n = run_time_usage(usage, &seconds);
+    if (n == 0)
+    {
+	shell_printf("no samples yet\n");
+	return;
+    }
+    shell_printf("CPU over the last %d s\n", seconds);
+    for (i = 0; i < n; i++)
+    {
+	shell_printf("%-12s %3u.%u%%\n", usage[i].name, usage[i].permille / 10, usage[i].permille % 10);
+    }
+}
+
+// The telnet output holds TELNETD_CONF_NUMLINES lines, so the frozen ring
+// goes out a page at a time: trace, then trace more until the end.
+// tools/trace_decode.py reads the pages back together. A new trace starts
+// over, and the ring records again after TRACE_FREEZE_SECONDS even when
+// nobody pages to the end.
+#define TRACE_PAGE_LINES 24
+static uint16_t trace_cursor;
+
+static void trace(char *str)
+{
+    trace_entry_t a, b;
+    int line;
+
+    if (strstr(str, "more") == NULL)
+    {
+	trace_freeze(true);
+	trace_cursor = 0;
+	shell_printf("trace %lu Hz %u\n", (unsigned long) RUN_TIME_TICKS_HZ, trace_count());
+    }
+    else if (!trace_is_frozen())
+    {
+	shell_printf("recording again, start over with trace\n");
+	return;
+    }
+    for (line = 0; line < TRACE_PAGE_LINES && trace_cursor < trace_count(); line++)
+    {
+	a = trace_get(trace_cursor++);
+	if (trace_cursor < trace_count())
+	{
+	    b = trace_get(trace_cursor++);
+	    shell_printf("%08lx %02x %04x %08lx %02x %04x\n", a.time, a.type, a.arg, b.time, b.type, b.arg);
+	}
+	else
+	{
+	    shell_printf("%08lx %02x %04x\n", a.time, a.type, a.arg);
+	}
+    }
+    if (trace_cursor < trace_count())
+    {
+	shell_printf("-- trace more --\n");
+    }
+    else
+    {
+	shell_printf("end\n");
+	trace_freeze(false);
+    }
+}
+
 static void start_grbl(char *str)
 {
 	shell_printf("Starting grbl... type exit to return to shell\n");
@@ -293,6 +408,92 @@ static void reset_grbl(char *str)
 	//start_grbl_task();
 }
 
+int shell_grbl_running(void)
+{
+    return grbl_running;
+}
+
+// without an argument only shows the rate
+static void push(char *str)
+{
+    char *arg = strchr(str, ' ');
+    char *end;
+    long hz;
+
+    if (arg != NULL)
+    {
+	hz = strtol(arg + 1, &end, 10);
+	while (*end == ' ') end++;
+	if (end == arg + 1 || *end != '\0' || hz < 0 || hz > STATUS_PUSH_HZ_MAX)
+	{
+	    shell_printf("usage: push [0-%d]\n", STATUS_PUSH_HZ_MAX);
+	    return;
+	}
+	status_push_set_rate(hz);
+    }
+    shell_printf("status push %d Hz\n", status_push_get_rate());
+}
+
+// without an argument only shows the override
+static void feed(char *str)
+{
+    char *arg = strchr(str, ' ');
+    char *end;
+    long percent;
+
+    if (arg != NULL)
+    {
+	percent = strtol(arg + 1, &end, 10);
+	while (*end == ' ') end++;
+	if (end == arg + 1 || *end != '\0' ||
+	    percent < FEED_OVERRIDE_MIN || percent > FEED_OVERRIDE_MAX)
+	{
+	    shell_printf("usage: feed [%d-%d]\n", FEED_OVERRIDE_MIN, FEED_OVERRIDE_MAX);
+	    return;
+	}
+	gcode_request_feed_override(percent);
+    }
+    shell_printf("feed override %u%%\n", gcode_get_feed_override());
+}
+
+static void print_isr_timing(const char *name, isr_timing_t *timing)
+{
+    int i;
+    if (timing->count == 0)
+    {
+	shell_printf("%s: no samples\n", name);
+	return;
+    }
+    shell_printf("%s: min %lu.%03lu us, max %lu.%03lu us, mean %lu us, %lu samples\n", name,
+		 timing->min / 1000, timing->min % 1000, timing->max / 1000, timing->max % 1000,
+		 timing->total / timing->count, timing->count);
+    for (i = 0; i < ISR_HISTOGRAM_SIZE; i++)
+    {
+	if (timing->histogram[i] == 0) continue;
+	if (i == 0)
+	    shell_printf("  < 1 us  %lu\n", timing->histogram[i]);
+	else if (i == ISR_HISTOGRAM_SIZE - 1)
+	    shell_printf(" >= %d us  %lu\n", 1 << (i - 1), timing->histogram[i]);
+	else
+	    shell_printf("  %d-%d us  %lu\n", 1 << (i - 1), 1 << i, timing->histogram[i]);
+    }
+}
+
+static void isr(char *str)
+{
+    isr_timing_t execution, latency;
+
+    if (strstr(str, "reset") != NULL)
+    {
+	stepper_clear_isr_timing();
+	shell_printf("cleared\n");
+	return;
+    }
+    stepper_get_isr_timing(&execution, &latency);
+    print_isr_timing("execution", &execution);
+    print_isr_timing("latency", &latency);
+}
+
 static void rm(char *str)
 {
     FRESULT result = f_unlink(str);
@@ -317,7 +518,14 @@ static struct ptentry parsetab[] =
     {"ls",       ls,           0},
     {"rm",       rm,           1},
     {"ps",       ps,           0},
+    {"top",      top,          0},
+    {"mem",      mem,          0},
+    {"stack",    stack,        0},
+    {"trace",    trace,        0},
     {"beep",     beep,         1},
+    {"feed",     feed,         0},
+    {"isr",      isr,          0},
+    {"push",     push,         0},
     {"exit",     shell_quit,   0},
     {"?",        help},
     {NULL, unknown}
@@ -78,6 +78,9 @@ void shell_input(char *command);
 void shell_quit(char *);
 void shell_send_str(char *);
 
+/* the session is streaming g-code to grbl, see the grbl command */
+int shell_grbl_running(void);
+
 
 /**
  * Print a string to the shell window.
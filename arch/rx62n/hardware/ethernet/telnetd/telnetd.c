@@ -56,6 +56,7 @@ MEMB(linemem, struct telnetd_line, TELNETD_CONF_NUMLINES);
 #define STATE_CLOSE  6
 
 static struct telnetd_state s;
+static struct uip_conn *session;  /* the open connection, NULL when none */
 
 #define TELNET_IAC   255
 #define TELNET_WILL  251
@@ -153,6 +154,16 @@ void shell_send_str(char *str)
 	
 }
 
+/*---------------------------------------------------------------------------*/
+struct uip_conn *
+telnetd_push(char *line)
+{
+  if(session == NULL || !shell_grbl_running()) {
+    return NULL;
+  }
+  shell_send_str(line);
+  return session;
+}
 /*---------------------------------------------------------------------------*/
 void
 telnetd_init(void)
@@ -331,6 +342,7 @@ telnetd_appcall(void)
   static unsigned int i;
   if(uip_connected()) {
     /*    tcp_markconn(uip_conn, &s);*/
+    session = uip_conn;
     for(i = 0; i < TELNETD_CONF_NUMLINES; ++i) {
       s.lines[i] = NULL;
     }
@@ -342,6 +354,7 @@ telnetd_appcall(void)
 
   if(s.state == STATE_CLOSE) {
     s.state = STATE_NORMAL;
+    session = NULL;
     uip_close();
     return;
   }
@@ -349,6 +362,7 @@ telnetd_appcall(void)
   if(uip_closed() ||
      uip_aborted() ||
      uip_timedout()) {
+    session = NULL;
     closed();
   }
   
@@ -56,4 +56,9 @@ struct telnetd_state {
 
 void telnetd_init(void);
 
+/* Queue a line on the session if it is streaming g-code, returns the
+   connection to poll for sending it, NULL when there is no such session. */
+struct uip_conn;
+struct uip_conn *telnetd_push(char *line);
+
 #endif /* __TELNETD_H__ */
@@ -67,6 +67,9 @@
 #include "net/clock-arch.h"
 #include "r_ether.h"
 #include "telnetd.h"
+#include "trace.h"
+#include "gcode.h"
+#include "status_push.h"
 //#include "network-apps/ftpd.h"
 
 /*-----------------------------------------------------------*/
@@ -74,6 +77,10 @@
 /* How long to wait before attempting to connect the MAC again. */
 #define uipINIT_WAIT    ( 100 / portTICK_RATE_MS )
 
+/* How long to wait for a Tx buffer to come back when there is none to work
+with.  The Tx end interrupt returns it without waking the task. */
+#define uipBUFFER_WAIT  ( 10 / portTICK_RATE_MS )
+
 /* Shortcut to the header within the Rx buffer. */
 #define xHeader ((struct uip_eth_hdr *) &uip_buf[ 0 ])
 
@@ -87,6 +94,16 @@
  */
 static void prvSetMACAddress( void );
 
+/*
+ * Pass the frame in uip_buf to the stack and send whatever it answers.
+ */
+static void prvProcessFrame( void );
+
+/*
+ * Ticks until the timer expires, 0 once it has.
+ */
+static portTickType prvTicksUntil( struct timer *pxTimer );
+
 /*
  * Port functions required by the uIP stack.
  */
@@ -114,9 +131,11 @@ clock_time_t clock_time( void )
 
 void vuIP_Task( void *pvParameters )
 {
-portBASE_TYPE i, xDoneSomething;
+portBASE_TYPE i;
 uip_ipaddr_t xIPAddr;
 struct timer periodic_timer, arp_timer;
+char cStatusFrame[ STATUS_FRAME_SIZE ];
+struct uip_conn *pxSession;
 
 	( void ) pvParameters;
 
@@ -152,43 +171,47 @@ struct timer periodic_timer, arp_timer;
 
 	for( ;; )
 	{
-		xDoneSomething = pdFALSE;
-		
-		/* Is there received data ready to be processed? */
-		uip_len = ( unsigned short ) ulEMACRead();
-		
-		if( ( uip_len > 0 ) && ( uip_buf != NULL ) )
+		/* Sleep until the EMAC ISR or the status push gives the semaphore,
+		or the periodic timer is due.  Nothing is polled while the network is
+		quiet. */
+		if( uip_buf != NULL )
 		{
-			/* Standard uIP loop taken from the uIP manual. */
-			if( xHeader->type == htons( UIP_ETHTYPE_IP ) )
-			{
-				uip_arp_ipin();
-				uip_input();
+			xSemaphoreTake( xEMACSemaphore, prvTicksUntil( &periodic_timer ) );
+		}
+		else
+		{
+			xSemaphoreTake( xEMACSemaphore, uipBUFFER_WAIT );
+		}
 
-				/* If the above function invocation resulted in data that
-				should be sent out on the network, the global variable
-				uip_len is set to a value > 0. */
-				if( uip_len > 0 )
-				{
-					uip_arp_out();
-					vEMACWrite();
-				}
-				
-				xDoneSomething = pdTRUE;
+		/* The semaphore is binary, one give can stand for several frames
+		received since the last wake up.  Take them all before blocking again
+		rather than one per wake up. */
+		for( ;; )
+		{
+			uip_len = ( unsigned short ) ulEMACRead();
+			if( uip_len == 0 )
+			{
+				break;
 			}
-			else if( xHeader->type == htons( UIP_ETHTYPE_ARP ) )
+			if( uip_buf != NULL )
 			{
-				uip_arp_arpin();
+				prvProcessFrame();
+			}
+		}
 
-				/* If the above function invocation resulted in data that
-				should be sent out on the network, the global variable
-				uip_len is set to a value > 0. */
+		/* A frame from the status push goes out on the telnet session right
+		away rather than with the next periodic poll. */
+		if( ( uip_buf != NULL ) && status_push_take_frame( cStatusFrame ) )
+		{
+			pxSession = telnetd_push( cStatusFrame );
+			if( pxSession != NULL )
+			{
+				uip_poll_conn( pxSession );
 				if( uip_len > 0 )
 				{
+					uip_arp_out();
 					vEMACWrite();
 				}
-				
-				xDoneSomething = pdTRUE;
 			}
 		}
 
@@ -215,22 +238,55 @@ struct timer periodic_timer, arp_timer;
 				timer_reset( &arp_timer );
 				uip_arp_timer();
 			}
-			
-			xDoneSomething = pdTRUE;
 		}
-		
-		if( xDoneSomething == pdFALSE )
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvProcessFrame( void )
+{
+	trace_event( TRACE_NET_FRAME, uip_len );
+
+	/* Standard uIP loop taken from the uIP manual. */
+	if( xHeader->type == htons( UIP_ETHTYPE_IP ) )
+	{
+		uip_arp_ipin();
+		uip_input();
+
+		/* If the above function invocation resulted in data that
+		should be sent out on the network, the global variable
+		uip_len is set to a value > 0. */
+		if( uip_len > 0 )
+		{
+			uip_arp_out();
+			vEMACWrite();
+		}
+	}
+	else if( xHeader->type == htons( UIP_ETHTYPE_ARP ) )
+	{
+		uip_arp_arpin();
+
+		/* If the above function invocation resulted in data that
+		should be sent out on the network, the global variable
+		uip_len is set to a value > 0. */
+		if( uip_len > 0 )
 		{
-			/* We did not receive a packet, and there was no periodic
-			processing to perform.  Block for a fixed period.  If a packet
-			is received during this period we will be woken by the ISR
-			giving us the Semaphore. */
-			xSemaphoreTake( xEMACSemaphore, configTICK_RATE_HZ / 20 );
+			vEMACWrite();
 		}
 	}
 }
 /*-----------------------------------------------------------*/
 
+static portTickType prvTicksUntil( struct timer *pxTimer )
+{
+	if( timer_expired( pxTimer ) )
+	{
+		return 0;
+	}
+	return ( portTickType ) timer_remaining( pxTimer );
+}
+/*-----------------------------------------------------------*/
+
 void prvSetMACAddress( void )
 {
 struct uip_eth_addr xAddr;
@@ -23,6 +23,9 @@ extern void vSoftwareInterruptISR( void );
 //extern void vT2_3_ISR_Handler( void );
 extern void vEMAC_ISR_Handler( void );
 extern void stepper_handler( void );
+extern void run_time_overflow_handler( void );
+extern void serial_error_handler( void );
+extern void serial_rx_handler( void );
 
 #define FVECT_SECT          __attribute__ ((section (".fvectors")))
 
@@ -162,7 +165,7 @@ const fp RelocatableVectors[] RVECT_SECT  = {
 //;0x0078  CMTU1_CMT2
 	(fp)stepper_handler,
 //;0x007C  CMTU1_CMT3
-	(fp)INT_Excep_CMTU1_CMT3,
+	(fp)run_time_overflow_handler,
 //;0x0080  Ether
     (fp)vEMAC_ISR_Handler,
 //;0x0084  Reserved
@@ -544,9 +547,9 @@ const fp RelocatableVectors[] RVECT_SECT  = {
 //;0x0374  SCI1_TEI1
     (fp)INT_Excep_SCI1_TEI1,
 //;0x0378  SCI2_ERI2
-    (fp)INT_Excep_SCI2_ERI2,
+    (fp)serial_error_handler,
 //;0x037C  SCI2_RXI2
-    (fp)INT_Excep_SCI2_RXI2,
+    (fp)serial_rx_handler,
 //;0x0380  SCI2_TXI2
     (fp)INT_Excep_SCI2_TXI2,
 //;0x0384  SCI2_TEI2
@@ -0,0 +1,226 @@
+/*
+   mem_pool.c - fixed block pools behind pvPortMalloc(), instead of heap_2
+   Part of LasaurGrbl
+
+   LasaurGrbl is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   LasaurGrbl is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   */
+
+/* heap_2 never merges free blocks, so deleting and creating tasks of
+   different sizes slowly eats a 45 KB heap. Here every allocation takes a
+   whole block from the smallest pool whose blocks are large enough and still
+   has one free, and vPortFree() puts it back on that pool's list. Nothing
+   fragments and the memory in use is known at build time.
+
+   The pools are sized after what is actually allocated: the kernel's TCBs and
+   queues, one byte of storage per semaphore or mutex, the planner's command
+   queue and the task stacks. The stack pools take their counts from the
+   *_STACK depths in mem_pool.h, which dev_misc.c creates the tasks with, and
+   the build fails when a task's depth has no pool. The network buffers are
+   not pooled: uip_buf and the EMAC descriptors are static arrays and never
+   were on the heap. The shell command mem shows each pool's high-water mark,
+   and how many requests spilled into a larger pool because it was full. */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "mem_pool.h"
+
+#define ALIGN(size) (((size) + portBYTE_ALIGNMENT - 1) & ~(size_t)(portBYTE_ALIGNMENT - 1))
+#define STACK(depth) ALIGN((depth) * configMINIMAL_STACK_SIZE * sizeof(portSTACK_TYPE))
+
+// the tasks of mem_pool.h whose stack is depth words
+#define TASKS_WITH_STACK(depth) ((GRBL_STACK == (depth)) + (PLANNER_STACK == (depth)) + \
+	(TEMP_ACCEL_STACK == (depth)) + (STATUS_STACK == (depth)) + (UIP_STACK == (depth)))
+
+#if TASKS_WITH_STACK(1) + TASKS_WITH_STACK(2) + TASKS_WITH_STACK(4) + \
+	TASKS_WITH_STACK(5) + TASKS_WITH_STACK(7) != TASK_STACKS
+#error A task stack depth in mem_pool.h has no pool, add a STACK() pool for it.
+#endif
+
+// block size, number of blocks
+#define POOLS \
+	POOL(16, 16)       /* storage of semaphores and mutexes, one byte each */ \
+	POOL(96, 24)       /* TCBs and queue headers */ \
+	POOL(STACK(1), TASKS_WITH_STACK(1) + 2)  /* and the idle stack, one spare */ \
+	POOL(STACK(2), TASKS_WITH_STACK(2) + 1)  /* and the planner command queue */ \
+	POOL(STACK(4), TASKS_WITH_STACK(4)) \
+	POOL(STACK(5), TASKS_WITH_STACK(5)) \
+	POOL(STACK(7), TASKS_WITH_STACK(7))
+
+typedef struct free_block {
+	struct free_block *next;
+} free_block_t;
+
+typedef struct {
+	size_t block_size;
+	unsigned short blocks;
+	unsigned char *start;     // of the pool's blocks in pool_memory
+	unsigned char *end;
+	free_block_t *free_list;
+	unsigned short used;
+	unsigned short max_used;
+	unsigned short spilled;
+} pool_t;
+
+#define POOL(size, count) { ALIGN(size), count },
+static pool_t pools[] = { POOLS };
+#undef POOL
+#define POOL_COUNT (sizeof(pools)/sizeof(pools[0]))
+
+#define POOL(size, count) + ALIGN(size) * (count)
+static union {
+	volatile portDOUBLE aligned;  // only for the alignment
+	unsigned char bytes[0 POOLS];
+} pool_memory;
+#undef POOL
+
+static unsigned short failures;
+static size_t min_free;
+static int initialised;
+
+
+static void init_pools(void)
+{
+	unsigned char *block = pool_memory.bytes;
+	free_block_t *free_block;
+	unsigned int i, j;
+
+	for (i = 0; i < POOL_COUNT; i++) {
+		pools[i].start = block;
+		pools[i].free_list = NULL;
+		for (j = 0; j < pools[i].blocks; j++) {
+			free_block = (free_block_t *) block;
+			free_block->next = pools[i].free_list;
+			pools[i].free_list = free_block;
+			block += pools[i].block_size;
+		}
+		pools[i].end = block;
+	}
+	min_free = sizeof(pool_memory.bytes);
+	initialised = 1;
+}
+
+void *pvPortMalloc(size_t xWantedSize)
+{
+	void *block = NULL;
+	int fitting = 1;  // the first pool large enough, it takes the blame for a spill
+	unsigned int i;
+
+	vTaskSuspendAll();
+	{
+		if (!initialised) {
+			init_pools();
+		}
+		for (i = 0; i < POOL_COUNT; i++) {
+			if (pools[i].block_size < xWantedSize) {
+				continue;
+			}
+			if (pools[i].free_list != NULL) {
+				block = pools[i].free_list;
+				pools[i].free_list = pools[i].free_list->next;
+				pools[i].used++;
+				if (pools[i].used > pools[i].max_used) {
+					pools[i].max_used = pools[i].used;
+				}
+				break;
+			}
+			if (fitting) {
+				pools[i].spilled++;
+				fitting = 0;
+			}
+		}
+		if (block == NULL) {
+			failures++;
+		} else if (xPortGetFreeHeapSize() < min_free) {
+			min_free = xPortGetFreeHeapSize();
+		}
+	}
+	xTaskResumeAll();
+
+	#if( configUSE_MALLOC_FAILED_HOOK == 1 )
+	{
+		if (block == NULL) {
+			extern void vApplicationMallocFailedHook(void);
+			vApplicationMallocFailedHook();
+		}
+	}
+	#endif
+
+	return block;
+}
+
+void vPortFree(void *pv)
+{
+	unsigned char *block = pv;
+	free_block_t *free_block;
+	unsigned int i;
+
+	if (block == NULL) {
+		return;
+	}
+	vTaskSuspendAll();
+	{
+		for (i = 0; i < POOL_COUNT; i++) {
+			if (block >= pools[i].start && block < pools[i].end) {
+				free_block = (free_block_t *) block;
+				free_block->next = pools[i].free_list;
+				pools[i].free_list = free_block;
+				pools[i].used--;
+				break;
+			}
+		}
+	}
+	xTaskResumeAll();
+}
+
+void vPortInitialiseBlocks(void)
+{
+	// the pools are set up on the first allocation
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+	size_t free_bytes = 0;
+	unsigned int i;
+
+	for (i = 0; i < POOL_COUNT; i++) {
+		free_bytes += (pools[i].blocks - pools[i].used) * pools[i].block_size;
+	}
+	return free_bytes;
+}
+
+int mem_pool_count(void)
+{
+	return POOL_COUNT;
+}
+
+void mem_pool_stats(int pool, mem_pool_stats_t *stats)
+{
+	vTaskSuspendAll();
+	stats->block_size = pools[pool].block_size;
+	stats->blocks = pools[pool].blocks;
+	stats->used = pools[pool].used;
+	stats->max_used = pools[pool].max_used;
+	stats->spilled = pools[pool].spilled;
+	xTaskResumeAll();
+}
+
+unsigned short mem_pool_failures(void)
+{
+	return failures;
+}
+
+size_t mem_pool_min_free(void)
+{
+	return initialised ? min_free : sizeof(pool_memory.bytes);
+}
@@ -0,0 +1,49 @@
+/*
+   mem_pool.h - fixed block pools behind pvPortMalloc(), instead of heap_2
+   Part of LasaurGrbl
+
+   LasaurGrbl is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   LasaurGrbl is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   */
+
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#include <stddef.h>
+
+// task stacks in configMINIMAL_STACK_SIZE words, dev_misc.c creates the tasks
+// with them and mem_pool.c sizes its stack pools from them
+#define GRBL_STACK        7
+#define PLANNER_STACK     4
+#define TEMP_ACCEL_STACK  2
+#define STATUS_STACK      2
+#define UIP_STACK         5
+#define TASK_STACKS       5  // the tasks above
+
+typedef struct {
+	size_t block_size;        // bytes
+	unsigned short blocks;
+	unsigned short used;
+	unsigned short max_used;  // high-water mark since the start
+	unsigned short spilled;   // requests that fitted here but went to a larger pool
+} mem_pool_stats_t;
+
+// number of pools, smallest blocks first
+int mem_pool_count(void);
+
+void mem_pool_stats(int pool, mem_pool_stats_t *stats);
+
+// allocations that found no block at all
+unsigned short mem_pool_failures(void);
+
+// the lowest xPortGetFreeHeapSize() so far, in bytes
+size_t mem_pool_min_free(void);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+   planner_task.c - runs the planner in its own task, fed by the parser through a queue
+   Part of LasaurGrbl
+
+   LasaurGrbl is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   LasaurGrbl is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   */
+
+/* The grbl task parses lines and queues the resulting motion commands, with the
+   targets already in steps. This task takes them off the queue and plans them.
+   When the block buffer is full only this task waits, the parser keeps reading
+   and acknowledging lines until the queue is full as well. Together they look
+   ahead PLANNER_QUEUE_SIZE commands further than the block buffer alone. */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "planner.h"
+#include "gcode.h"
+#include "dev_misc.h"
+
+#define PLANNER_QUEUE_SIZE 32
+
+static xQueueHandle command_queue;
+static xSemaphoreHandle planner_mutex;
+static volatile unsigned portBASE_TYPE commands_pending;  // queued or being planned
+
+
+// called from main() before the scheduler starts
+void planner_queue_init()
+{
+	command_queue = xQueueCreate(PLANNER_QUEUE_SIZE, sizeof(motion_command_t));
+	planner_mutex = xSemaphoreCreateMutex();
+	commands_pending = 0;
+}
+
+// called by the parser, keeps the real-time commands going while the queue is full
+void planner_queue(motion_command_t *command)
+{
+	taskENTER_CRITICAL();
+	commands_pending++;
+	taskEXIT_CRITICAL();
+	while(xQueueSend(command_queue, command, 10/portTICK_RATE_MS) != pdPASS) {
+		gcode_execute_runtime();
+	}
+}
+
+// true when everything queued has made it into the block buffer
+bool planner_queue_idle()
+{
+	return commands_pending == 0;
+}
+
+void planner_lock()
+{
+	xSemaphoreTake(planner_mutex, portMAX_DELAY);
+}
+
+void planner_unlock()
+{
+	xSemaphoreGive(planner_mutex);
+}
+
+void planner_task(void *pvParameters)
+{
+	motion_command_t command;
+	for( ;; ) {
+		if(xQueueReceive(command_queue, &command, portMAX_DELAY) == pdPASS) {
+			planner_execute(&command);
+			taskENTER_CRITICAL();
+			commands_pending--;
+			taskEXIT_CRITICAL();
+			sleep_mode_wake();  // for stepper_synchronize()
+		}
+	}
+}
@@ -0,0 +1,208 @@
+/*
+   run_time.c - time base for the FreeRTOS run time stats, per task CPU and stack usage
+   Part of LasaurGrbl
+
+   LasaurGrbl is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   LasaurGrbl is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   */
+
+/* CMT3 runs free at PCLK/8 (6 MHz) and its compare match at 0xFFFF counts the
+   overflows, every 10.9 ms. The run time counter is both together divided by
+   16, 375 kHz, which wraps after 3.2 hours. The stepper interrupt reads CMT3
+   directly to time itself, the event trace takes the full rate from
+   run_time_ticks().
+
+   FreeRTOS adds the counter's progress to a task whenever it is switched out.
+   vTaskGetRunTimeStats() reports these sums since the start, its percentages
+   overflow after two minutes. run_time_sample() keeps the sums of the last
+   RUN_TIME_WINDOW seconds instead and run_time_usage() takes the differences.
+
+   The kernel fills every stack with 0xa5 when the task is created, and
+   uxTaskGetStackHighWaterMark() counts how much of that is still there. It
+   needs the task's handle, so dev_misc.c adds each task here as it creates it.
+   The idle task has no handle to get in this FreeRTOS version. */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "iodefine.h"
+
+#include "run_time.h"
+
+typedef struct {
+	void *handle;
+	const char *name;
+	unsigned short stack_depth;  // words, as given to xTaskCreate()
+} task_entry_t;
+
+typedef struct {
+	unsigned long total;                           // run_time_counter()
+	unsigned long counter[RUN_TIME_TASKS_MAX];     // per task, by slot
+} run_time_sample_t;
+
+static volatile unsigned long overflows;
+static char task_names[RUN_TIME_TASKS_MAX][configMAX_TASK_NAME_LEN];  // slots
+static run_time_sample_t samples[RUN_TIME_WINDOW+1];
+static int newest_sample;
+static int sample_count;
+static signed char stats_text[RUN_TIME_TASKS_MAX*40];
+static task_entry_t tasks[RUN_TIME_TASKS_MAX];
+static int task_count;
+
+void run_time_overflow_handler(void) __attribute__((interrupt));
+
+
+void run_time_timer_init(void)
+{
+	MSTP( CMT3 ) = 0;
+
+	/* Count the overflows on compare match. */
+	CMT3.CMCR.BIT.CMIE = 1;
+	CMT3.CMCOR = 0xFFFF;
+
+	/* Divide the PCLK by 8. */
+	CMT3.CMCR.BIT.CKS = 0;
+
+	_IEN( _CMT3_CMI3 ) = 1;
+	_IPR( _CMT3_CMI3 ) = configKERNEL_INTERRUPT_PRIORITY;
+
+	CMT.CMSTR1.BIT.STR3 = 1;
+}
+
+void run_time_overflow_handler(void)
+{
+	overflows++;
+}
+
+static void read_timer(unsigned long *high, unsigned short *low)
+{
+	do {
+		*high = overflows;
+		*low = CMT3.CMCNT;
+	} while (*high != overflows);
+	// called from the kernel with the overflow interrupt masked, it may be pending
+	if (IR(CMT3, CMI3) && *low < 0x8000) {
+		(*high)++;
+	}
+}
+
+unsigned long run_time_counter(void)
+{
+	unsigned long high;
+	unsigned short low;
+	read_timer(&high, &low);
+	return (high << 12) | (low >> 4);
+}
+
+unsigned long run_time_ticks(void)
+{
+	unsigned long high;
+	unsigned short low;
+	read_timer(&high, &low);
+	return (high << 16) | low;
+}
+
+static int task_slot(const char *name)
+{
+	int i;
+	for (i = 0; i < RUN_TIME_TASKS_MAX; i++) {
+		if (task_names[i][0] == 0) {
+			strncpy(task_names[i], name, configMAX_TASK_NAME_LEN-1);
+			return i;
+		}
+		if (strncmp(task_names[i], name, configMAX_TASK_NAME_LEN-1) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void run_time_sample(void)
+{
+	run_time_sample_t sample;
+	char *line, *end, *tab;
+	int slot;
+
+	// an empty line, then lines of "name\t\tcounter\t\tpercent%\r\n", with the
+	// scheduler suspended but the interrupts, and so the stepper, running
+	vTaskGetRunTimeStats(stats_text);
+	memset(&sample, 0, sizeof(sample));
+	sample.total = run_time_counter();
+	for (line = (char *)stats_text; (end = strchr(line, '\n')) != NULL; line = end + 1) {
+		tab = memchr(line, '\t', end - line);
+		if (tab == NULL) {
+			continue;
+		}
+		*tab = 0;
+		slot = task_slot(line);
+		if (slot >= 0) {
+			sample.counter[slot] = strtoul(tab+1, NULL, 10);
+		}
+	}
+
+	vTaskSuspendAll();
+	newest_sample = (newest_sample + 1) % (RUN_TIME_WINDOW+1);
+	samples[newest_sample] = sample;
+	if (sample_count < RUN_TIME_WINDOW+1) {
+		sample_count++;
+	}
+	xTaskResumeAll();
+}
+
+int run_time_usage(task_usage_t *usage, int *seconds)
+{
+	run_time_sample_t *newest, *oldest;
+	unsigned long total;
+	int i, n = 0;
+
+	vTaskSuspendAll();
+	*seconds = sample_count - 1;
+	if (sample_count >= 2) {
+		newest = &samples[newest_sample];
+		oldest = &samples[(newest_sample + RUN_TIME_WINDOW+1 - *seconds) % (RUN_TIME_WINDOW+1)];
+		total = newest->total - oldest->total;
+		for (i = 0; i < RUN_TIME_TASKS_MAX && task_names[i][0] != 0; i++) {
+			strcpy(usage[n].name, task_names[i]);
+			usage[n].permille = total ? ((newest->counter[i] - oldest->counter[i])*1000UL)/total : 0;
+			if (usage[n].permille > 1000) {  // created within the window, counted from 0
+				usage[n].permille = 1000;
+			}
+			n++;
+		}
+	}
+	xTaskResumeAll();
+	return n;
+}
+
+void run_time_add_task(void *handle, const char *name, unsigned short stack_depth)
+{
+	if (handle == NULL || task_count >= RUN_TIME_TASKS_MAX) {
+		return;
+	}
+	tasks[task_count].handle = handle;
+	tasks[task_count].name = name;
+	tasks[task_count].stack_depth = stack_depth;
+	task_count++;
+}
+
+int run_time_stacks(task_stack_t *stacks)
+{
+	int i;
+
+	for (i = 0; i < task_count; i++) {
+		strncpy(stacks[i].name, tasks[i].name, configMAX_TASK_NAME_LEN-1);
+		stacks[i].name[configMAX_TASK_NAME_LEN-1] = 0;
+		stacks[i].size = tasks[i].stack_depth * sizeof(portSTACK_TYPE);
+		stacks[i].free_min = uxTaskGetStackHighWaterMark(tasks[i].handle) * sizeof(portSTACK_TYPE);
+	}
+	return task_count;
+}
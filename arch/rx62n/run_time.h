@@ -0,0 +1,57 @@
+/*
+   run_time.h - time base for the FreeRTOS run time stats, per task CPU and stack usage
+   Part of LasaurGrbl
+
+   LasaurGrbl is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   LasaurGrbl is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   */
+
+#ifndef RUN_TIME_H
+#define RUN_TIME_H
+
+#include "board.h"
+
+#define RUN_TIME_TASKS_MAX 8
+#define RUN_TIME_WINDOW 5  // seconds the CPU usage is averaged over
+
+typedef struct {
+	char name[configMAX_TASK_NAME_LEN];
+	unsigned short permille;  // of the CPU over the window
+} task_usage_t;
+
+typedef struct {
+	char name[configMAX_TASK_NAME_LEN];
+	unsigned short size;      // bytes of stack
+	unsigned short free_min;  // bytes never touched so far, the high-water mark
+} task_stack_t;
+
+#define RUN_TIME_TICKS_HZ (PCLK_FREQUENCY/8)
+
+// portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() and portGET_RUN_TIME_COUNTER_VALUE()
+void run_time_timer_init(void);
+unsigned long run_time_counter(void);
+
+// CMT3 extended to 32 bits, RUN_TIME_TICKS_HZ, wraps after 12 minutes
+unsigned long run_time_ticks(void);
+
+// called once a second, keeps RUN_TIME_WINDOW seconds of counters
+void run_time_sample(void);
+
+// CPU usage per task over the last window, returns the number of tasks
+// filled in and the seconds actually covered (less right after the start)
+int run_time_usage(task_usage_t *usage, int *seconds);
+
+// remember a task created with xTaskCreate() for run_time_stacks()
+void run_time_add_task(void *handle, const char *name, unsigned short stack_depth);
+
+// stack use of the tasks added, returns the number filled in
+int run_time_stacks(task_stack_t *stacks);
+
+#endif
@@ -27,25 +27,58 @@
 #include "stdint.h"
 #include "shell.h" 
 #include "serial.h" 
+#include "gcode.h"
+#include "trace.h"
 
 #include <iodefine.h>
 #include <board.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
-//#include "semphr.h"
+#include "semphr.h"
 
 #define RX_BUFFER_SIZE 2048
 #define TX_BUFFER_SIZE 128
 char tx_buffer[RX_BUFFER_SIZE];
 int tx_bffr_i = 0x00;
 
-void serial_init(long baud)
+static xSemaphoreHandle tx_mutex;   // the port, held for a whole line
+static xTaskHandle tx_holder;       // task in the middle of a line, NULL when none
+static xSemaphoreHandle rx_signal;  // given for every byte received, see serial_wait()
+
+void serial_rx_handler(void) __attribute__((interrupt));
+void serial_error_handler(void) __attribute__((interrupt));
+
+/* Bytes come in by the receive interrupt, which stores them and wakes the grbl
+   task waiting in serial_wait(). A task polling the flag would have to run
+   at the grbl task's priority or above and never block. The interrupt sits
+   just above the kernel's, below the syscall limit, so it can give the
+   semaphore and is taken before a stepper interrupt pending at the same
+   time: the SCI holds one byte, at 115200 baud it has to be read within
+   87 us. */
+#define SERIAL_RX_INTERRUPT_PRIORITY (configKERNEL_INTERRUPT_PRIORITY + 1)
+
+void serial_init()
 {
-	// already initialised before the start of the FreeRTOS scheduler
+	// the SCI is already initialised before the start of the FreeRTOS scheduler
+	tx_mutex = xSemaphoreCreateMutex();
+	vSemaphoreCreateBinary(rx_signal);
+
+	IR(SCI2, RXI2) = 0;
+	IPR(SCI2, RXI2) = SERIAL_RX_INTERRUPT_PRIORITY;  // ERI2 shares the register
+	IEN(SCI2, ERI2) = 1;
+	IEN(SCI2, RXI2) = 1;
 }
 
 void serial_write(uint8_t data) {	
+	// before the scheduler runs there is nobody to share the port with
+	bool locking = tx_mutex != NULL && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+
+	if (locking && tx_holder != xTaskGetCurrentTaskHandle()) {
+		xSemaphoreTake(tx_mutex, portMAX_DELAY);
+		tx_holder = xTaskGetCurrentTaskHandle();
+	}
+
 #if 0 // dont use the shell
 	if(tx_bffr_i > TX_BUFFER_SIZE-2) {
 		shell_send_str("buffer to small!\n");
@@ -62,11 +95,29 @@ void serial_write(uint8_t data) {
 	}
 #endif
 	sci2_putchar(data);
+	if (locking && data == '\n') {
+		tx_holder = NULL;
+		xSemaphoreGive(tx_mutex);
+	}
+}
+
+// never waits, a status frame is better dropped than late
+bool serial_write_line(const char *line)
+{
+	if (tx_mutex == NULL || xSemaphoreTake(tx_mutex, 0) != pdTRUE) {
+		return false;
+	}
+	while (*line) {
+		sci2_putchar(*line++);
+	}
+	xSemaphoreGive(tx_mutex);
+	return true;
 }
 
 uint8_t rx_buffer[RX_BUFFER_SIZE];
-uint8_t rx_buffer_head = 0;
-uint8_t rx_buffer_tail = 0;
+volatile uint16_t rx_buffer_head = 0;
+volatile uint16_t rx_buffer_tail = 0;
+static volatile uint16_t overrun_count = 0;
 
 //xSemaphoreHandle serial_mutex;
 
@@ -89,7 +140,7 @@ uint8_t serial_read()
 	} else {
 		//vSemaphoreMutexTake(serial_mutex, portMAX_DELAY);	
 		uint8_t data = rx_buffer[rx_buffer_tail];
-		if (rx_buffer_tail == RX_BUFFER_SIZE)  
+		if (rx_buffer_tail == RX_BUFFER_SIZE-1)  
 			rx_buffer_tail = 0; 
 		else
 			rx_buffer_tail++;
@@ -101,37 +152,81 @@ uint8_t serial_read()
 
 
 
+// discard all received but not yet read data
+// only call this from the reading side
+void serial_reset_read_buffer()
+{
+	rx_buffer_tail = rx_buffer_head;
+}
+
+void serial_wait(uint16_t timeout_ms)
+{
+	if (rx_buffer_head == rx_buffer_tail) {
+		xSemaphoreTake(rx_signal, timeout_ms/portTICK_RATE_MS);
+	}
+}
+
+uint16_t serial_available()
+{
+	return (rx_buffer_head - rx_buffer_tail + RX_BUFFER_SIZE) % RX_BUFFER_SIZE;
+}
+
+uint16_t serial_get_overrun_count()
+{
+	return overrun_count;
+}
+
 void serial_receive_c(char c)
 {
 	uint8_t data = c;
-	uint8_t next_head = rx_buffer_head + 1;
+	// real-time commands are acted on right here, they never wait
+	// behind buffered lines and never reach the parser
+	if (gcode_runtime_command(data)) { return; }
+
+	uint16_t next_head = rx_buffer_head + 1;
 	if (next_head == RX_BUFFER_SIZE) { next_head = 0; }
 
 	// Write data to buffer unless it is full.
 	if (next_head != rx_buffer_tail) {
 		rx_buffer[rx_buffer_head] = data;
 		rx_buffer_head = next_head;
+	} else {
+		overrun_count++;
+		trace_event(TRACE_BYTE_OVERRUN, data);
 	}
 }
 
+// the telnet session in grbl mode, the receive interrupt writes the same buffer
+static void receive_from_task(char c)
+{
+	uint32_t psw = dev_irq_save();
+	serial_receive_c(c);
+	dev_irq_restore(psw);
+}
+
 void serial_receive(char *str) 
 {
-	while(*str) serial_receive_c(*str++); // add check whether the buffer is full.
+	while(*str) receive_from_task(*str++); // add check whether the buffer is full.
 	if(*(str-1) != '\n')
-		serial_receive_c('\n');
+		receive_from_task('\n');
+	xSemaphoreGive(rx_signal);
 }
 
-void serial_poll_task(void *ptr)
+void serial_rx_handler(void)
 {
-	//vSemaphoreCreateMutex(&serial_mutex);
-	while(1) {
-		if(IR(SCI2, RXI2) == 1){
-			char c = SCI2.RDR; 
-	//		vSemaphoreMutexTake(serial_mutex, portMAX_DELAY);	
-			serial_receive_c(c);
-	//		vSemaphoreMutexGive(serial_mutex);	
-			IR(SCI2, RXI2) = 0; // clear flag
-		}
-		taskYIELD();
+	long woken = pdFALSE;
+
+	serial_receive_c(SCI2.RDR);
+	xSemaphoreGiveFromISR(rx_signal, &woken);
+	portYIELD_FROM_ISR(woken);
+}
+
+// an overrun, framing or parity error stops the receiver until it is cleared
+void serial_error_handler(void)
+{
+	if (SCI2.SSR.BIT.ORER) {
+		overrun_count++;
+		trace_event(TRACE_BYTE_OVERRUN, 0);
 	}
+	SCI2.SSR.BYTE &= ~0x38;  // ORER, FER and PER
 }
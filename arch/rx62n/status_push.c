@@ -0,0 +1,94 @@
+/*
+   status_push.c - status frames pushed at a fixed rate instead of polled with '?'
+   Part of LasaurGrbl
+
+   LasaurGrbl is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   LasaurGrbl is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   */
+
+/* The task formats a frame with gcode_status_frame() every period and writes
+   it to the serial port between two response lines, a frame that would have
+   to wait for the port is dropped. The same frame is left for the uIP task,
+   which puts it on the telnet session while that is in grbl mode. Nothing
+   here runs in the grbl task, the g-code stream is not held up. */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "gcode.h"
+#include "serial.h"
+#include "config.h"
+#include "status_push.h"
+
+#define IDLE_POLL_MS 100  // how often a disabled push looks at the rate again
+
+extern xSemaphoreHandle xEMACSemaphore;
+
+static volatile int push_hz = CONFIG_STATUS_PUSH_HZ;
+static char net_frame[STATUS_FRAME_SIZE];
+static volatile bool net_frame_ready;
+
+
+void status_push_set_rate(int hz)
+{
+	push_hz = max(0, min(hz, STATUS_PUSH_HZ_MAX));
+}
+
+int status_push_get_rate(void)
+{
+	return push_hz;
+}
+
+bool status_push_take_frame(char *frame)
+{
+	bool ready;
+
+	taskENTER_CRITICAL();
+	ready = net_frame_ready;
+	if (ready) {
+		memcpy(frame, net_frame, STATUS_FRAME_SIZE);
+		net_frame_ready = false;
+	}
+	taskEXIT_CRITICAL();
+	return ready;
+}
+
+void status_push_task(void *pvParameters)
+{
+	portTickType xLastWakeTime;
+	char frame[STATUS_FRAME_SIZE];
+	int hz;
+
+	xLastWakeTime = xTaskGetTickCount();
+
+	for( ;; ) {
+		hz = push_hz;
+		if (hz == 0) {
+			vTaskDelay(IDLE_POLL_MS/portTICK_RATE_MS);
+			xLastWakeTime = xTaskGetTickCount();
+			continue;
+		}
+		vTaskDelayUntil(&xLastWakeTime, configTICK_RATE_HZ/hz);
+
+		gcode_status_frame(frame);
+		serial_write_line(frame);
+
+		taskENTER_CRITICAL();
+		memcpy(net_frame, frame, STATUS_FRAME_SIZE);
+		net_frame_ready = true;
+		taskEXIT_CRITICAL();
+		if (xEMACSemaphore != NULL) {
+			xSemaphoreGive(xEMACSemaphore);  // wake the uIP task
+		}
+	}
+}
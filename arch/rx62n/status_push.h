@@ -0,0 +1,33 @@
+/*
+   status_push.h - status frames pushed at a fixed rate instead of polled with '?'
+   Part of LasaurGrbl
+
+   LasaurGrbl is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   LasaurGrbl is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   */
+
+#ifndef STATUS_PUSH_H
+#define STATUS_PUSH_H
+
+#include <stdbool.h>
+
+#define STATUS_PUSH_HZ_MAX 50
+
+// frames per second, 0 turns the push off, clamped to STATUS_PUSH_HZ_MAX
+void status_push_set_rate(int hz);
+int status_push_get_rate(void);
+
+void status_push_task(void *pvParameters);
+
+// for the uIP task: the newest frame not yet sent to the network,
+// false when there is none
+bool status_push_take_frame(char *frame);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+  dev_misc.c - the simulator, runs the firmware as a Linux process
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+/* There are no tasks. The grbl loop runs as the only thread, as it does without
+   PLANNER_TASK, and the stepper interrupt is fired from wherever it waits. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dev_misc.h"
+#include "iodefine.h"
+#include "stepper.h"
+#include "config.h"
+#include "step_trace.h"
+#include "trace.h"
+#include "gcode.h"
+#include "serial.h"
+
+#define TICK_NS 1000000ULL  // sleep_mode() waits one tick, the longest it waits on the board
+#define INJECTIONS_MAX 16
+
+extern void stepper_handler();  // dev_stepper.c
+extern int grbl_main(void);
+extern void serial_open(const char *path, long baud);
+extern void serial_open_network(int bytes, long period_us);
+extern void serial_stream_stats(uint32_t *line_count, uint64_t *ns);
+extern void serial_inject(const char *bytes);
+
+typedef struct {
+	uint64_t at;                 // virtual ns
+	const char *bytes;
+} injection_t;
+
+volatile struct st_port PORTA;
+
+static uint64_t now;             // virtual time in ns
+static uint64_t step_period;     // ns between stepper interrupts
+static uint64_t next_step;       // when the stepper interrupt fires next
+static FILE *event_file;         // -r, the event ring is dumped there at the end
+static uint64_t push_period;     // -s, ns between status frames, 0 when off
+static uint64_t next_push;       // when the next one is due
+static injection_t injections[INJECTIONS_MAX];  // -i, in time order
+static int injection_count;
+static int next_injection;
+
+
+uint64_t sim_time() {
+	return now;
+}
+
+uint32_t dev_timestamp() {
+	return now / (1000000000ULL/DEV_TIMESTAMP_HZ);
+}
+
+bool dev_memory_headroom(uint32_t *stack_free, uint32_t *heap_free) {
+	// no tasks and no pools on the host
+	return false;
+}
+
+void sim_step_timer(uint64_t period_ns) {
+	// like reloading the compare match register, the running period completes first
+	step_period = period_ns;
+}
+
+// like the push task on the board, a frame that finds a response
+// half written is dropped
+static void push_status() {
+	char frame[STATUS_FRAME_SIZE];
+	gcode_status_frame(frame);
+	serial_write_line(frame);
+}
+
+void sim_run(uint64_t ns) {
+	uint64_t until = now + ns;
+	uint64_t next;
+	for (;;) {
+		if (do_int && next_step < now) { next_step = now + step_period; }  // timer was off
+		next = do_int ? next_step : UINT64_MAX;
+		if (push_period && next_push < next) { next = next_push; }
+		if (next_injection < injection_count && injections[next_injection].at < next) {
+			next = max(now, injections[next_injection].at);
+		}
+		if (next > until) { break; }
+		now = next;
+		if (next_injection < injection_count && now >= injections[next_injection].at) {
+			serial_inject(injections[next_injection++].bytes);
+		} else if (push_period && now == next_push) {
+			next_push += push_period;
+			push_status();
+		} else {
+			next_step += step_period;
+			stepper_handler();
+		}
+	}
+	now = until;
+}
+
+void led_toggle() {
+}
+
+extern void printString(const char * );
+
+void dev_print_flash(const char *s) {
+	printString(s);
+}
+
+void dev_enable_ints() {
+}
+
+void dev_disable_ints() {
+}
+
+void delay_ms(double time_ms) {
+	sim_run(time_ms * 1000000);
+}
+
+void delay_us(double time_us) {
+	sim_run(time_us * 1000);
+}
+
+// give the stepper one tick
+void sleep_mode() {
+	sim_run(TICK_NS);
+}
+
+static int by_time(const void *a, const void *b) {
+	const injection_t *x = a, *y = b;
+	return (x->at > y->at) - (x->at < y->at);
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [-b baud | -n bytes/us] [-t trace.csv|trace.vcd] [-r events.txt] [-s hz]\n"
+	                "          [-i ms:bytes ...] [job.gcode]\n"
+	                "  feeds the job (default stdin) to the firmware, replies go to stdout\n"
+	                "  -b  deliver the input at this baud rate instead of as fast as it is read\n"
+	                "  -n  deliver it in network segments of bytes every us microseconds\n"
+	                "  -t  record every step event, as VCD for a .vcd file, CSV otherwise\n"
+	                "  -r  dump the event ring at the end, see tools/trace_decode.py\n"
+	                "  -s  push a status frame this many times a virtual second\n"
+	                "  -i  receive the bytes at ms of virtual time, eg: -i 1500:! -i 3000:~\n", name);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	const char *path = NULL;
+	long baud = 0;
+	int i;
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-b") && i+1 < argc) {
+			baud = atol(argv[++i]);
+		} else if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			int bytes;
+			long period_us;
+			if (sscanf(argv[++i], "%d/%ld", &bytes, &period_us) != 2 || bytes < 1 || period_us < 1) {
+				usage(argv[0]);
+			}
+			serial_open_network(bytes, period_us);
+		} else if (!strcmp(argv[i], "-t") && i+1 < argc) {
+			step_trace_open(argv[++i]);
+		} else if (!strcmp(argv[i], "-r") && i+1 < argc) {
+			event_file = fopen(argv[++i], "w");
+			if (event_file == NULL) { perror(argv[i]); exit(1); }
+		} else if (!strcmp(argv[i], "-s") && i+1 < argc) {
+			int hz = atoi(argv[++i]);
+			push_period = 1000000000ULL / max(1, hz);
+			next_push = push_period;
+		} else if (!strcmp(argv[i], "-i") && i+1 < argc && injection_count < INJECTIONS_MAX) {
+			double ms;
+			int length = 0;
+			if (sscanf(argv[++i], "%lf:%n", &ms, &length) != 1 || length == 0 || ms < 0) {
+				usage(argv[0]);
+			}
+			injections[injection_count].at = ms * 1000000;
+			injections[injection_count].bytes = argv[i] + length;
+			injection_count++;
+		} else if (argv[i][0] == '-' && argv[i][1] != 0) {
+			usage(argv[0]);
+		} else {
+			path = argv[i];
+		}
+	}
+	qsort(injections, injection_count, sizeof(injection_t), by_time);
+	serial_open(path, baud);
+	grbl_main();
+	return 0;
+}
+
+// called by serial_read() once the input is used up and the stepper went idle
+void sim_exit() {
+	double position[3];
+	uint32_t lines;
+	uint64_t streamed;
+	step_trace_close();
+	if (event_file) {
+		// same format as the shell's trace command
+		uint16_t i;
+		trace_freeze(true);
+		fprintf(event_file, "trace %d Hz %u\n", DEV_TIMESTAMP_HZ, trace_count());
+		for (i = 0; i < trace_count(); i++) {
+			trace_entry_t entry = trace_get(i);
+			fprintf(event_file, "%08x %02x %04x\n", entry.time, entry.type, entry.arg);
+		}
+		fclose(event_file);
+	}
+	stepper_get_position(position);
+	serial_stream_stats(&lines, &streamed);
+	fflush(stdout);
+	fprintf(stderr, "simulated %.3f s, position X%.3f Y%.3f Z%.3f, starved %u, "
+	        "%u lines read in %.3f s, %.0f lines/s\n", now * 1e-9,
+	        position[X_AXIS], position[Y_AXIS], position[Z_AXIS],
+	        stepper_get_starvation_count(), lines, streamed * 1e-9,
+	        streamed ? lines / (streamed * 1e-9) : 0.0);
+	exit(0);
+}
@@ -0,0 +1,37 @@
+#ifndef ARCH_MISC_H
+#define ARCH_MISC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PSTR	 /**/ 
+
+void dev_print_flash(const char *s);
+void dev_enable_ints();
+void dev_disable_ints();
+void delay_ms(double time_ms);
+void delay_us(double time_us);
+void sleep_mode();
+void led_toggle();
+
+// virtual us for the event trace, see trace.c
+uint32_t dev_timestamp();
+#define DEV_TIMESTAMP_HZ 1000000
+
+// smallest stack headroom of any task and the lowest free heap so far, in
+// bytes, false where there is nothing to measure
+bool dev_memory_headroom(uint32_t *stack_free, uint32_t *heap_free);
+
+// there is nothing to interrupt the single thread
+static inline uint32_t dev_irq_save() { return 0; }
+static inline void dev_irq_restore(uint32_t flags) { (void)flags; }
+
+// Virtual time. Nothing takes time in the simulator except waiting: sleep_mode(),
+// the delays and an empty serial port let virtual time pass, firing the stepper
+// interrupt as it comes due. The job thus runs as fast as the host can go while
+// the motion keeps the timing it would have on the machine.
+uint64_t sim_time();                      // ns since start
+void sim_run(uint64_t ns);                // let ns pass
+void sim_step_timer(uint64_t period_ns);  // period of the stepper interrupt, see dev_stepper.c
+
+#endif
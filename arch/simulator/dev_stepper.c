@@ -0,0 +1,52 @@
+/*
+  dev_stepper.c - the simulator side of stepper.c: step timer and step trace
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+/* sim_run() fires stepper_handler() at the period set here, in virtual time.
+   There are no pins, the steps go to the step trace as they would go out on
+   the rx62n, with the laser as it is then. */
+
+#include <time.h>
+#include "dev_misc.h"
+#include "stepper.h"
+#include "config.h"
+#include "sense_control.h"
+#include "step_trace.h"
+
+
+void dev_stepper_init() {
+}
+
+void dev_stepper_period(uint32_t steps_per_minute) {
+	sim_step_timer(60000000000ULL/steps_per_minute);  // ns between step events
+}
+
+// The execution time is the host's, virtual time fires the interrupt on time.
+void stepper_handler() {
+	struct timespec entry, exit;
+
+	if(!do_int)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &entry);
+	stepper_interrupt();
+	clock_gettime(CLOCK_MONOTONIC, &exit);
+	stepper_record_isr_timing((exit.tv_sec - entry.tv_sec)*1000000000L + (exit.tv_nsec - entry.tv_nsec), 0);
+}
+
+void dev_stepper_pulse(uint8_t out_bits) {
+	if (out_bits & STEPPING_MASK) {
+		step_trace_event(sim_time(), out_bits, control_get_laser_intensity());
+	}
+}
@@ -0,0 +1,29 @@
+/*
+  iodefine.h - the rx62n registers the portable code touches
+  Part of LasaurGrbl
+
+  Only the laser output in sense_control.c, as a plain variable.
+*/
+
+#ifndef IODEFINE_H
+#define IODEFINE_H
+
+struct st_port {
+	union {
+		unsigned char BYTE;
+		struct {
+			unsigned char B0:1;
+			unsigned char B1:1;
+			unsigned char B2:1;
+			unsigned char B3:1;
+			unsigned char B4:1;
+			unsigned char B5:1;
+			unsigned char B6:1;
+			unsigned char B7:1;
+		} BIT;
+	} DR;
+};
+
+extern volatile struct st_port PORTA;
+
+#endif
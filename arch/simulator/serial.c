@@ -0,0 +1,188 @@
+/*
+  serial.c - the serial port of the simulator, fed from a file or stdin
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+/* The input arrives in the receive buffer as the firmware reads, as long as there
+   is room, like a host that counts characters. With a baud rate every byte also
+   takes its time on the wire in virtual time; with a network segment size and
+   period it comes in bursts instead, the way the uIP task hands a telnet
+   stream over. Real-time commands go through gcode_runtime_command() on
+   arrival as with serial_receive_c() on the rx62n. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "dev_misc.h"
+#include "stdint.h"
+#include "serial.h" 
+#include "stepper.h"
+#include "gcode.h"
+#include "trace.h"
+
+#define RX_BUFFER_SIZE 2048
+#define BITS_PER_BYTE 10  // start, 8 data, stop
+
+extern void sim_exit();
+
+static FILE *input;
+static bool input_done;         // input used up, a final newline has been added
+static uint64_t byte_ns;        // virtual ns per byte on the wire, 0 when unlimited
+static uint64_t next_byte;      // virtual time the next byte has arrived
+static int segment_bytes;       // network segments instead of a wire, 0 when off
+static uint64_t segment_ns;     // between two segments
+static int segment_left;        // bytes of the current segment not yet delivered
+static uint32_t lines;          // newlines received
+static uint64_t streamed_at;    // when the last byte was read
+
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
+static uint16_t rx_buffer_head = 0;
+static uint16_t rx_buffer_tail = 0;
+static uint16_t overrun_count = 0;
+static bool line_open;          // the last byte received was not a newline
+static bool tx_line_open;       // a response line is half written
+
+static void serial_receive_c(uint8_t data);
+static void receive_input();
+
+
+void serial_open(const char *path, long baud) {
+	input = path ? fopen(path, "rb") : stdin;
+	if (input == NULL) { perror(path); exit(1); }
+	byte_ns = baud > 0 ? 1000000000ULL*BITS_PER_BYTE/baud : 0;
+}
+
+void serial_open_network(int bytes, long period_us) {
+	segment_bytes = bytes;
+	segment_ns = period_us * 1000ULL;
+	segment_left = bytes;
+}
+
+// lines of the job and the virtual time it took to read them all
+void serial_stream_stats(uint32_t *line_count, uint64_t *ns) {
+	*line_count = lines;
+	*ns = streamed_at;
+}
+
+void serial_init() {
+}
+
+void serial_write(uint8_t data) {
+	putchar(data);
+	tx_line_open = (data != '\n');
+}
+
+// status frames come between stepper interrupts, never inside a response
+bool serial_write_line(const char *line) {
+	if (tx_line_open) { return false; }
+	fputs(line, stdout);
+	return true;
+}
+
+uint8_t serial_read() {
+	receive_input();
+	if (rx_buffer_head == rx_buffer_tail) {
+		if (input_done) {
+			// nothing more to come, finish the motion and report. Tick by tick
+			// like stepper_synchronize(), but through the grbl loop so the
+			// real-time bytes of -i are still acted on.
+			if (stepper_get_state() == STEPPER_IDLE) { sim_exit(); }
+			sleep_mode();
+		}
+		return SERIAL_NO_DATA;
+	} else {
+		streamed_at = sim_time();
+		uint8_t data = rx_buffer[rx_buffer_tail];
+		if (rx_buffer_tail == RX_BUFFER_SIZE-1)  
+			rx_buffer_tail = 0; 
+		else
+			rx_buffer_tail++;
+		return data;
+	}
+}
+
+// wait for the next byte or segment, or a tick when there is no wire
+void serial_wait(uint16_t timeout_ms) {
+	uint64_t wait = 1000000;
+	if (rx_buffer_head != rx_buffer_tail || input_done) { return; }
+	if ((byte_ns || segment_bytes) && next_byte > sim_time()) { wait = next_byte - sim_time(); }
+	sim_run(min(wait, timeout_ms * 1000000ULL));
+}
+
+// bytes typed in while the job runs, see -i, they skip the wire
+void serial_inject(const char *bytes) {
+	while (*bytes) {
+		serial_receive_c(*bytes++);
+	}
+}
+
+// discard all received but not yet read data
+// only call this from the reading side
+void serial_reset_read_buffer() {
+	rx_buffer_tail = rx_buffer_head;
+}
+
+uint16_t serial_available() {
+	return (rx_buffer_head - rx_buffer_tail + RX_BUFFER_SIZE) % RX_BUFFER_SIZE;
+}
+
+uint16_t serial_get_overrun_count() {
+	return overrun_count;
+}
+
+// move what has arrived by now from the input into the receive buffer
+static void receive_input() {
+	int c;
+	uint16_t next_head;
+	while (!input_done && next_byte <= sim_time()) {
+		next_head = rx_buffer_head + 1;
+		if (next_head == RX_BUFFER_SIZE) { next_head = 0; }
+		if (next_head == rx_buffer_tail) { return; }  // full, the host waits
+		c = getc(input);
+		if (c == EOF) {
+			if (line_open) { serial_receive_c('\n'); }
+			input_done = true;
+			return;
+		}
+		serial_receive_c(c);
+		if (segment_bytes) {
+			if (--segment_left <= 0) {
+				// the rest waits for the next segment
+				segment_left = segment_bytes;
+				next_byte = max(next_byte, sim_time()) + segment_ns;
+			}
+		} else {
+			next_byte = max(next_byte, sim_time()) + byte_ns;
+		}
+	}
+}
+
+static void serial_receive_c(uint8_t data) {
+	// real-time commands are acted on right here, they never wait
+	// behind buffered lines and never reach the parser
+	if (gcode_runtime_command(data)) { return; }
+
+	uint16_t next_head = rx_buffer_head + 1;
+	if (next_head == RX_BUFFER_SIZE) { next_head = 0; }
+
+	// Write data to buffer unless it is full.
+	if (next_head != rx_buffer_tail) {
+		rx_buffer[rx_buffer_head] = data;
+		rx_buffer_head = next_head;
+		line_open = (data != '\n');
+		if (data == '\n') { lines++; }
+	} else {
+		overrun_count++;
+		trace_event(TRACE_BYTE_OVERRUN, data);
+	}
+}
@@ -0,0 +1,168 @@
+/*
+  step_trace.c - records the step events of a simulated run
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+/* The stepper handler only appends a packed event (6 bytes) to the buffer, the
+   formatting happens when it is full, outside of the step timing.
+
+   CSV, one line per step event:
+     time_ns,x,y,z,laser
+   x, y, z are -1, 0 or 1 steps, laser is the intensity 0-255.
+
+   VCD, 1 ns timescale: step and direction wires per axis and the laser
+   intensity as an 8 bit vector. The step wires go high for
+   CONFIG_PULSE_MICROSECONDS.
+
+   tools/step_trace.py turns the CSV into velocity and acceleration curves. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "step_trace.h"
+#include "config.h"
+
+#define TRACE_BUFFER_SIZE 4096  // events
+#define PULSE_NS (CONFIG_PULSE_MICROSECONDS*1000ULL)
+
+typedef struct {
+  uint32_t delta_ns;   // since the previous event
+  uint8_t out_bits;
+  uint8_t intensity;
+} __attribute__((packed)) trace_event_t;
+
+static FILE *trace_file = NULL;
+static uint8_t trace_vcd;
+static trace_event_t trace_buffer[TRACE_BUFFER_SIZE];
+static uint16_t trace_count;
+static uint64_t trace_time;       // of the last event put in the buffer
+static uint64_t written_time;     // of the last event written out
+static uint64_t pulse_end;        // VCD: step wires high until then, 0 when low
+static uint8_t written_bits;      // VCD: last direction bits written
+static int written_intensity;     // VCD: last intensity written, -1 for none
+
+static void write_events();
+static void write_vcd_header();
+static void write_vcd_event(uint64_t time, uint8_t out_bits, uint8_t intensity);
+
+
+void step_trace_open(const char *path) {
+  const char *dot = strrchr(path, '.');
+  trace_file = fopen(path, "w");
+  if (trace_file == NULL) { perror(path); exit(1); }
+  trace_vcd = (dot != NULL && strcmp(dot, ".vcd") == 0);
+  trace_count = 0;
+  trace_time = written_time = pulse_end = 0;
+  written_bits = 0;
+  written_intensity = -1;
+  if (trace_vcd) {
+    write_vcd_header();
+  } else {
+    fprintf(trace_file, "time_ns,x,y,z,laser\n");
+  }
+}
+
+void step_trace_event(uint64_t time_ns, uint8_t out_bits, uint8_t intensity) {
+  if (trace_file == NULL) { return; }
+  if (trace_count == TRACE_BUFFER_SIZE) { write_events(); }
+  // steps are at least a pulse apart, a delta never needs 64 bits
+  // unless the machine stood still for over 4 s, then split the gap
+  while (time_ns - trace_time > UINT32_MAX) {
+    trace_buffer[trace_count++] = (trace_event_t){ UINT32_MAX, out_bits & ~STEPPING_MASK, intensity };
+    trace_time += UINT32_MAX;
+    if (trace_count == TRACE_BUFFER_SIZE) { write_events(); }
+  }
+  trace_buffer[trace_count++] = (trace_event_t){ time_ns - trace_time, out_bits, intensity };
+  trace_time = time_ns;
+}
+
+void step_trace_close() {
+  if (trace_file == NULL) { return; }
+  write_events();
+  if (trace_vcd && pulse_end) {
+    fprintf(trace_file, "#%llu\n0x\n0y\n0z\n", (unsigned long long)pulse_end);
+  }
+  fclose(trace_file);
+  trace_file = NULL;
+}
+
+
+static int axis_step(uint8_t out_bits, uint8_t step_bit, uint8_t direction_bit) {
+  if (!(out_bits & (1<<step_bit))) { return 0; }
+  return (out_bits & (1<<direction_bit)) ? -1 : 1;
+}
+
+static void write_events() {
+  uint16_t i;
+  for (i = 0; i < trace_count; i++) {
+    trace_event_t *event = &trace_buffer[i];
+    written_time += event->delta_ns;
+    if (!(event->out_bits & STEPPING_MASK)) { continue; }  // filler for a long gap
+    if (trace_vcd) {
+      write_vcd_event(written_time, event->out_bits, event->intensity);
+    } else {
+      fprintf(trace_file, "%llu,%d,%d,%d,%u\n", (unsigned long long)written_time,
+              axis_step(event->out_bits, X_STEP_BIT, X_DIRECTION_BIT),
+              axis_step(event->out_bits, Y_STEP_BIT, Y_DIRECTION_BIT),
+              axis_step(event->out_bits, Z_STEP_BIT, Z_DIRECTION_BIT),
+              event->intensity);
+    }
+  }
+  trace_count = 0;
+}
+
+static void write_vcd_header() {
+  fprintf(trace_file,
+          "$timescale 1ns $end\n"
+          "$scope module grbl $end\n"
+          "$var wire 1 x x_step $end\n"
+          "$var wire 1 X x_dir $end\n"
+          "$var wire 1 y y_step $end\n"
+          "$var wire 1 Y y_dir $end\n"
+          "$var wire 1 z z_step $end\n"
+          "$var wire 1 Z z_dir $end\n"
+          "$var wire 8 l laser $end\n"
+          "$upscope $end\n"
+          "$enddefinitions $end\n"
+          "#0\n0x\n0X\n0y\n0Y\n0z\n0Z\nb0 l\n");
+  written_intensity = 0;
+}
+
+static void write_vcd_bits(uint8_t bits, uint8_t step_bit, uint8_t direction_bit, char step_id, char direction_id) {
+  if ((bits ^ written_bits) & (1<<direction_bit)) {
+    fprintf(trace_file, "%d%c\n", (bits >> direction_bit) & 1, direction_id);
+  }
+  if (bits & (1<<step_bit)) {
+    fprintf(trace_file, "1%c\n", step_id);
+  }
+}
+
+static void write_vcd_event(uint64_t time, uint8_t out_bits, uint8_t intensity) {
+  int i;
+  if (pulse_end) {
+    // end the previous pulse, early if the next step comes first
+    fprintf(trace_file, "#%llu\n0x\n0y\n0z\n", (unsigned long long)(pulse_end < time ? pulse_end : time-1));
+  }
+  fprintf(trace_file, "#%llu\n", (unsigned long long)time);
+  if (intensity != written_intensity) {
+    fputc('b', trace_file);
+    for (i = 7; i >= 0; i--) { fputc('0' + ((intensity >> i) & 1), trace_file); }
+    fprintf(trace_file, " l\n");
+    written_intensity = intensity;
+  }
+  write_vcd_bits(out_bits, X_STEP_BIT, X_DIRECTION_BIT, 'x', 'X');
+  write_vcd_bits(out_bits, Y_STEP_BIT, Y_DIRECTION_BIT, 'y', 'Y');
+  write_vcd_bits(out_bits, Z_STEP_BIT, Z_DIRECTION_BIT, 'z', 'Z');
+  written_bits = out_bits;
+  pulse_end = time + PULSE_NS;
+}
@@ -0,0 +1,31 @@
+/*
+  step_trace.h - records the step events of a simulated run
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+#ifndef step_trace_h
+#define step_trace_h
+
+#include <stdint.h>
+
+// Start recording into path, as VCD when it ends in .vcd, CSV otherwise.
+void step_trace_open(const char *path);
+
+// Record the steps and directions in out_bits at time_ns with the laser at
+// intensity. Does nothing unless a trace is open.
+void step_trace_event(uint64_t time_ns, uint8_t out_bits, uint8_t intensity);
+
+// Write out what is still buffered and close the file.
+void step_trace_close();
+
+#endif
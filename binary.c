@@ -0,0 +1,127 @@
+/*
+  binary.c - compact binary motion frames
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+/*
+  Raster jobs are thousands of short moves that only differ in a few steps
+  and the intensity. As g-code each one costs around 20 bytes and two strtod()
+  passes. As a binary move it is usually 3 bytes fed straight into the planner.
+  See tools/binary_stream.py for the host side.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "binary.h"
+#include "gcode.h"
+#include "planner.h"
+#include "config.h"
+
+
+static double feed_table[BINARY_FEED_TABLE_SIZE];  // feed rates selected by index in move frames
+static uint8_t expected_sequence;                  // sequence number of the next frame
+
+static uint16_t crc16(uint8_t *data, int length);
+static uint8_t *read_varint(uint8_t *data, uint8_t *end, int32_t *value);
+static uint8_t *read_move(uint8_t *data, uint8_t *end, int32_t *dx, int32_t *dy, uint8_t *intensity);
+
+
+
+void binary_init() {
+  uint8_t i;
+  for (i=0; i<BINARY_FEED_TABLE_SIZE; i++) {
+    feed_table[i] = CONFIG_FEEDRATE;
+  }
+  expected_sequence = 0;
+}
+
+
+// A rejected frame does not advance the sequence, the host
+// resends from the first frame that did not get an "ok".
+uint8_t binary_execute_frame(uint8_t *frame, int length) {
+  if (length < 4) { return STATUS_BINARY_FRAME; }
+  uint16_t crc = frame[length-2] | (frame[length-1] << 8);
+  if (crc16(frame, length-2) != crc) { return STATUS_BINARY_CRC; }
+  if (frame[0] != expected_sequence) { return STATUS_BINARY_SEQUENCE; }
+
+  uint8_t *payload = frame + 2;
+  uint8_t *end = frame + length - 2;
+  uint8_t *move;
+  int32_t dx, dy;
+  uint8_t intensity;
+  switch (frame[1]) {
+    case BINARY_TYPE_FEED:
+      if (end-payload != 3 || payload[0] >= BINARY_FEED_TABLE_SIZE) { return STATUS_BINARY_FRAME; }
+      // like F0 in g-code, a zero feed would plan blocks that never move
+      if ((payload[1] | payload[2]) == 0) { return STATUS_BINARY_FRAME; }
+      feed_table[payload[0]] = (uint16_t)(payload[1] | (payload[2] << 8));
+      break;
+    case BINARY_TYPE_MOVES:
+      if (end-payload < 4 || payload[0] >= BINARY_FEED_TABLE_SIZE) { return STATUS_BINARY_FRAME; }
+      // check the whole frame first, it executes completely or not at all
+      move = payload+1;
+      while (move != NULL && move < end) {
+        move = read_move(move, end, &dx, &dy, &intensity);
+      }
+      if (move == NULL) { return STATUS_BINARY_FRAME; }
+      move = payload+1;
+      while (move < end) {
+        move = read_move(move, end, &dx, &dy, &intensity);
+        planner_line_relative_steps(dx, dy, 0, feed_table[payload[0]], intensity);
+      }
+      break;
+    default:
+      return STATUS_BINARY_FRAME;
+  }
+  expected_sequence++;
+  return STATUS_OK;
+}
+
+
+static uint16_t crc16(uint8_t *data, int length) {
+  uint16_t crc = 0xffff;
+  uint8_t i;
+  while (length--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (i=0; i<8; i++) {
+      if (crc & 0x8000) { crc = (crc << 1) ^ 0x1021; }
+      else { crc <<= 1; }
+    }
+  }
+  return crc;
+}
+
+// Decode a zigzag varint. Returns the position after it or NULL if it runs past end.
+static uint8_t *read_varint(uint8_t *data, uint8_t *end, int32_t *value) {
+  uint32_t raw = 0;
+  uint8_t shift = 0;
+  if (data == NULL) { return NULL; }
+  while (data < end && shift < 35) {
+    raw |= (uint32_t)(*data & 0x7f) << shift;
+    if (!(*data++ & 0x80)) {
+      *value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+      return data;
+    }
+    shift += 7;
+  }
+  return NULL;
+}
+
+// Decode one move. Returns the position after it or NULL if it runs past end.
+static uint8_t *read_move(uint8_t *data, uint8_t *end, int32_t *dx, int32_t *dy, uint8_t *intensity) {
+  data = read_varint(data, end, dx);
+  data = read_varint(data, end, dy);
+  if (data == NULL || data >= end) { return NULL; }
+  *intensity = *data;
+  return data+1;
+}
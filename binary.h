@@ -0,0 +1,49 @@
+/*
+  binary.h - compact binary motion frames
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+#ifndef binary_h
+#define binary_h
+
+#include <stdint.h>
+
+
+// On the wire a frame is a line starting with BINARY_SOF and ending in '\n'.
+// In between every byte is sent as byte^BINARY_WHITEN, which moves the zeros
+// of small deltas out of the control range. A whitened byte that could be
+// mistaken for a line end, a real-time command, flow control or telnet IAC
+// is sent as BINARY_ESC, whitened^BINARY_ESC_XOR. This keeps frames intact on
+// the serial and the telnet channel.
+#define BINARY_SOF      0x02
+#define BINARY_ESC      0x7d
+#define BINARY_ESC_XOR  0x20
+#define BINARY_WHITEN   0x40
+
+// Unescaped frame: sequence(1) type(1) payload(n) crc16(2, little endian)
+// The crc is CRC-16/CCITT (poly 0x1021, init 0xffff) over sequence to payload.
+#define BINARY_TYPE_FEED   0x01  // index(1) feed_rate(2, mm/min)
+#define BINARY_TYPE_MOVES  0x02  // feed_index(1) followed by 1 or more moves
+// A move is dx, dy in steps relative to the previous move, each as a zigzag
+// varint (7 bits per byte, least significant first, bit 7 set on all but the
+// last byte), followed by the intensity(1). Raster moves take 3 bytes.
+
+#define BINARY_FEED_TABLE_SIZE 16
+
+
+void binary_init();
+
+// Execute one unescaped frame, returns a STATUS_* code
+uint8_t binary_execute_frame(uint8_t *frame, int length);
+
+#endif
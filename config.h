@@ -36,11 +36,16 @@
 #define CONFIG_SEEKRATE (1500.0)
 #define CONFIG_ACCELERATION 1000000.0 // mm/min^2, typically 1000000-8000000, divide by (60*60) to get mm/sec^2
 #define CONFIG_JUNCTION_DEVIATION 0.05 // mm
+#define CONFIG_BLEND_TOLERANCE 0.1 // mm, path tolerance of G64 without P, G61 (exact path) is the default
+#define CONFIG_ARC_TOLERANCE 0.01 // mm, max deviation of the G2/G3 line segments from the true arc
+#define CONFIG_SPLINE_TOLERANCE 0.01 // mm, max deviation of the G5 line segments from the true curve
+#define CONFIG_ARC_SEGMENT_TIME 0.005 // seconds, shortest arc or spline segment at the current feed
 #define CONFIG_X_ORIGIN_OFFSET 0  // mm, x-offset of table origin from physical home
 #define CONFIG_Y_ORIGIN_OFFSET 0  // mm, y-offset of table origin from physical home
 #define CONFIG_Z_ORIGIN_OFFSET 0.0   // mm, z-offset of table origin from physical home
 #define CONFIG_INVERT_X_AXIS 0  // 0 is regular, 1 inverts the x direction
 #define CONFIG_INVERT_Y_AXIS 0  // 0 is regular, 1 inverts the y direction
+#define CONFIG_STATUS_PUSH_HZ 0  // status frames per second without asking, 0 is off, see README
 
 
 #define LIMITS_OVERWRITE_DDR     DDRD
@@ -114,6 +119,17 @@
 // if unwanted behavior is observed on a user's machine when running at very slow speeds.
 #define ZERO_SPEED 0.0 // (mm/min)
 
+// Short-segment slowdown. When the blocks in the buffer take less than CONFIG_SLOWDOWN_BUFFER_TIME
+// to execute, new blocks are slowed down to last at least CONFIG_SLOWDOWN_SEGMENT_TIME scaled by
+// how far the buffer is below that. This gives a host that cannot keep up with very short
+// blocks time to catch up before the buffer runs dry and the machine has to stop.
+#define CONFIG_SLOWDOWN_BUFFER_TIME 0.2 // (seconds)
+#define CONFIG_SLOWDOWN_SEGMENT_TIME 0.02 // (seconds)
+
+// When the stepper runs out of blocks and the next one arrives within this time the buffer
+// was starved rather than the job over. Counted in stepper_get_starvation_count().
+#define STARVATION_TIME_MS 1000
+
 // Minimum stepper rate. Sets the absolute minimum stepper rate in the stepper program and never runs
 // slower than this value, except when sleeping. This parameter overrides the minimum planner speed.
 // This is primarily used to guarantee that the end of a movement is always reached and not stop to
@@ -121,12 +137,34 @@
 #define MINIMUM_STEPS_PER_MINUTE 800U // (steps/min) - Integer value only
 // 1600 @ 32step_per_mm = 50mm/min
 
+// Arcs are traced by rotating the radius vector segment by segment. Every ARC_CORRECTION
+// segments it is recomputed exactly with sin/cos to remove the accumulated rounding error.
+// ARC_SEGMENTS_MAX caps the segments of a single arc, eg: a huge radius at a tiny tolerance.
+#define ARC_CORRECTION 25
+#define ARC_SEGMENTS_MAX 10000
+#define ARC_ANGULAR_TRAVEL_EPSILON 5E-7 // rad, below this the start and end angle are the same
+
+// G5 splines are split in halves until flat. This caps the splits, and with it the stack of
+// halves waiting to be traced: a curve becomes at most 2^SPLINE_DEPTH_MAX segments.
+#define SPLINE_DEPTH_MAX 12
+
 #define CHAR_XOFF   '\x13'
 #define CHAR_XON    '\x11'
 // #define CHAR_STOP   '\x03'
 // #define CHAR_RESUME '\x02'
-#define CHAR_STOP   '!'
+#define CHAR_FEED_HOLD '!'
 #define CHAR_RESUME '~'
+#define CHAR_STATUS '?'
+#define CHAR_RESET  '\x18'  // ctrl-x
+
+// Feed override bytes, outside of ascii so they never collide with g-code
+#define CHAR_FEED_OVR_RESET     0x90  // back to 100%
+#define CHAR_FEED_OVR_PLUS_10   0x91
+#define CHAR_FEED_OVR_MINUS_10  0x92
+#define CHAR_FEED_OVR_PLUS_1    0x93
+#define CHAR_FEED_OVR_MINUS_1   0x94
+#define FEED_OVERRIDE_MIN 10   // (percent)
+#define FEED_OVERRIDE_MAX 200  // (percent)
 
 #define X_AXIS 0
 #define Y_AXIS 1
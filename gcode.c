@@ -23,14 +23,18 @@
 #include "dev_misc.h"
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include "errno.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include "gcode.h"
 #include "config.h"
 #include "serial.h"
 #include "sense_control.h"
+#include "binary.h"
 #include "planner.h"
+#include "trace.h"
 #include "stepper.h"
 
 #define MM_PER_INCH (25.4)
@@ -44,19 +48,99 @@
 #define NEXT_ACTION_AIRGAS_DISABLE 6
 #define NEXT_ACTION_AIR_ENABLE 7
 #define NEXT_ACTION_GAS_ENABLE 8
+#define NEXT_ACTION_ARC_CW 9
+#define NEXT_ACTION_ARC_CCW 10
+#define NEXT_ACTION_SPLINE 11
 
 
 #define OFFSET_G54 0
 #define OFFSET_G55 1
 
-#define BUFFER_LINE_SIZE 80
-char rx_line[BUFFER_LINE_SIZE];
+#define PATH_EXACT 0     // G61
+#define PATH_BLENDING 1  // G64
+
+// Lines are not buffered, protocol_process() feeds the characters straight
+// into the word recorder below. Only binary frames need a buffer.
+#define LINE_EMPTY 0
+#define LINE_GCODE 1
+#define LINE_DOLLAR 2
+#define LINE_BINARY 3
+static uint8_t line_type;    // what the current line turned out to be
+
+// With nothing received protocol_process() sleeps in serial_wait(). Bytes and
+// real-time commands wake it, this only bounds the wait for anything else.
+#define SERIAL_WAIT_MS 50
+
+#define BUFFER_FRAME_SIZE 80
+static uint8_t rx_frame[BUFFER_FRAME_SIZE];
+static int rx_frame_length;  // length of the unescaped binary frame in rx_frame
 
 #define FAIL(status) gc.status_code = status;
 
+// Numbers are read as an integer mantissa divided by a power of ten. As long as both
+// are exact in a double the division is correctly rounded, ie: bit-identical to strtod().
+// Anything longer falls back to strtod(). With 32 bit doubles the exact range is smaller.
+#if DBL_MANT_DIG >= 53
+#define EXACT_MANTISSA_MAX 999999999UL  // 9 digits
+#define EXACT_DECIMALS_MAX 22
+#else
+#define EXACT_MANTISSA_MAX 16777215UL   // 2^24-1
+#define EXACT_DECIMALS_MAX 10
+#endif
+static const double powers_of_ten[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Longer numbers are only kept for strtod() up to this many characters.
+// Past that they cannot be exact either and fail with STATUS_BAD_NUMBER_FORMAT.
+#define NUMBER_TOKEN_SIZE 40
+
+typedef struct {
+  bool negative;
+  bool isdecimal;
+  bool exact;                      // mantissa holds all the digits
+  uint8_t digits;                  // saturates at 255
+  uint8_t decimals;                // saturates at 255
+  uint8_t length;                  // characters in token, saturates at NUMBER_TOKEN_SIZE
+  uint32_t mantissa;
+  char token[NUMBER_TOKEN_SIZE];   // the raw characters for the strtod() fallback
+} number_reader_t;
+
+// The words of the line being received, recorded as they complete.
+// Nothing takes effect before the line is complete and error free.
+typedef struct {
+  int8_t motion_mode;              // -1 when not given, else {G0, G1, G2, G3, G5}
+  int8_t inches_mode;              // -1 when not given, else {G20, G21}
+  int8_t absolute_mode;            // -1 when not given, else {G90, G91}
+  int8_t offselect;                // -1 when not given, else {G54, G55}
+  int8_t path_mode;                // -1 when not given, else {G61, G64}
+  uint8_t next_action;
+  uint8_t axis_mask;               // axes given, bit per X_AXIS..Z_AXIS
+  double axis_words[3];
+  double arc_offset[3];            // {I, J, K}, arc center relative to the start
+  uint8_t arc_offset_mask;         // offsets given, bit per I, J, K
+  bool got_r_word;
+  double r_word;                   // arc radius, negative for the long way round
+  bool got_feed_word;
+  double feed_word;
+  bool got_s_word;
+  double s_word;
+  bool got_p_word;
+  double p;
+  bool got_q_word;
+  double q;                        // G5 second control point, Y relative to the end
+  int l;
+  bool got_n_word;
+  uint32_t n;                      // line number
+  char letter;                     // letter of the word in progress, 0 when none
+  number_reader_t number;          // its number
+} line_words_t;
+static line_words_t words;
+
 typedef struct {
   uint8_t status_code;             // return codes
-  uint8_t motion_mode;             // {G0, G1}
+  uint8_t motion_mode;             // {G0, G1, G2, G3, G5}
   bool inches_mode;                // 0 = millimeter mode, 1 = inches mode {G20, G21}
   bool absolute_mode;              // 0 = relative motion, 1 = absolute motion {G90, G91}
   double feed_rate;                // mm/min {F}
@@ -64,15 +148,32 @@ typedef struct {
   double position[3];              // projected position once all scheduled motions will have been executed
   double offsets[6];               // coord system offsets {G54_X,G54_Y,G54_Z,G55_X,G55_Y,G55_Z}
   uint8_t offselect;               // currently active offset, 0 -> G54, 1 -> G55
+  double blend_tolerance;          // mm, corners may be rounded within this, 0 -> G61 {G61, G64 P}
   uint8_t nominal_laser_intensity; // 0-255 percentage
+  bool spline_continues;           // the last motion was a G5, the next one may omit I and J
+  double spline_control[2];        // second control point of that G5, relative to its end
+  uint32_t line_number;            // N word of the last line, else counted up per line
 } parser_state_t;
 static parser_state_t gc;
 
 static volatile bool position_update_requested;  // make sure to update to stepper position on next occasion
+static volatile bool status_report_requested;    // report position on next occasion, set by CHAR_STATUS
+static volatile bool reset_requested;            // abort the job on next occasion, set by CHAR_RESET
+static volatile bool resume_requested;           // continue after a hold or stop, set by CHAR_RESUME
+static volatile uint8_t feed_override;           // requested feed override in percent, see CHAR_FEED_OVR_*
 
 // prototypes for static functions (non-accesible from other files)
-static int next_statement(char *letter, double *double_ptr, char *line, uint8_t *char_counter);
-static int read_double(char *line, uint8_t *char_counter, double *double_ptr);
+static void words_begin();
+static void words_feed(char c);
+static void words_end();
+static void complete_word();
+static uint8_t execute_words();
+static void trace_arc(double *position, double *target, double *offset, bool isclockwise);
+static void trace_spline(double *position, double *target, double *control_1, double *control_2);
+static void number_begin(number_reader_t *number);
+static bool number_feed(number_reader_t *number, char c);
+static bool number_value(number_reader_t *number, double *double_ptr);
+static void print_axes(double x, double y, double z);
 
 
 void gcode_init() {
@@ -94,55 +195,89 @@ void gcode_init() {
   gc.offsets[3+Y_AXIS] = CONFIG_Y_ORIGIN_OFFSET;
   gc.offsets[3+Z_AXIS] = CONFIG_Z_ORIGIN_OFFSET;
   position_update_requested = false;
+  status_report_requested = false;
+  reset_requested = false;
+  resume_requested = false;
+  feed_override = 100;
+  binary_init();
 }
 
 void protocol_process()
 {
-  char c;
-  int char_counter = 0;
+  uint8_t c;
   uint8_t iscomment = false;
+  uint8_t isescaped = false;
+  line_type = LINE_EMPTY;
+  rx_frame_length = 0;
+  words_begin();
 	while(1) {
+  gcode_execute_runtime();
+  if (reset_requested) {
+    // drop the partial line and everything still buffered, the stepper
+    // is already absorbing the planned blocks (see gcode_runtime_command)
+    serial_reset_read_buffer();
+    iscomment = false;
+    isescaped = false;
+    line_type = LINE_EMPTY;
+    rx_frame_length = 0;
+    words_begin();
+    binary_init();
+    stepper_clear_starvation_count();
+    gc.line_number = 0;
+    stepper_synchronize();
+    stepper_resume();
+    reset_requested = false;
+    printPgmString(PSTR("\nLasaurGrbl " LASAURGRBL_VERSION "\n"));
+  }
   while((c = serial_read()) != SERIAL_NO_DATA) 
   {
     if ((c == '\n') || (c == '\r')) { // End of line reached
-      if (char_counter > 0) {// Line is complete. Then execute!
-        rx_line[char_counter] = 0; // Terminate string
-        //status_message(protocol_execute_line(line));
-      	return;
-	} else { 
-        // Empty or comment line. Skip block.
-        rx_line[char_counter] = 0; // Terminate string
-        return;
+      if (line_type == LINE_GCODE) {
+        words_end();  // complete the last word
       }
-      char_counter = 0; // Reset line buffer index
-      iscomment = false; // Reset comment flag
+      return;
+    } else if (line_type == LINE_BINARY) {
+      // Undo the escaping, overlong frames are truncated and fail the crc
+      if (isescaped) {
+        c ^= BINARY_ESC_XOR;
+        isescaped = false;
+      } else if (c == BINARY_ESC) {
+        isescaped = true;
+        continue;
+      }
+      if (rx_frame_length < BUFFER_FRAME_SIZE) {
+        rx_frame[rx_frame_length++] = c ^ BINARY_WHITEN;
+      }
+    } else if (line_type == LINE_DOLLAR) {
+      // Throw away the rest of the line
+    } else if (iscomment) {
+      // Throw away all comment characters
+      if (c == ')') {
+        // End of comment. Resume line.
+        iscomment = false;
+      }
+    } else if (c == BINARY_SOF && line_type == LINE_EMPTY) {
+      line_type = LINE_BINARY;
+    } else if (c <= ' ') { 
+      // Throw away whitepace and control characters
+    } else if (c == '/') {
+      // Disable block delete and throw away character
+      // To enable block delete, uncomment following line. Will ignore until EOL.
+      // iscomment = true;
+    } else if (c == '(') {
+      // Enable comments flag and ignore all characters until ')' or EOL.
+      iscomment = true;
+    } else if (c == '$' && line_type == LINE_EMPTY) {
+      line_type = LINE_DOLLAR;
     } else {
-      if (iscomment) {
-        // Throw away all comment characters
-        if (c == ')') {
-          // End of comment. Resume line.
-          iscomment = false;
-        }
-      } else {
-        if (c <= ' ') { 
-          // Throw away whitepace and control characters
-        } else if (c == '/') {
-          // Disable block delete and throw away character
-          // To enable block delete, uncomment following line. Will ignore until EOL.
-          // iscomment = true;
-        } else if (c == '(') {
-          // Enable comments flag and ignore all characters until ')' or EOL.
-          iscomment = true;
-        } else if (char_counter >= BUFFER_LINE_SIZE-1) {
-          // Throw away any characters beyond the end of the line buffer
-        } else if (c >= 'a' && c <= 'z') { // Upcase lowercase
-          rx_line[char_counter++] = c-'a'+'A';
-        } else {
-          rx_line[char_counter++] = c;
-        }
+      line_type = LINE_GCODE;
+      if (c >= 'a' && c <= 'z') { // Upcase lowercase
+        c = c-'a'+'A';
       }
+      words_feed(c);
     }
   }
+  serial_wait(SERIAL_WAIT_MS);
 }	
 }
 
@@ -151,33 +286,38 @@ void gcode_process_line() {
   int status_code;
     
 	protocol_process();
+  // every answered line counts, the host can match it to its own count
+  if (line_type == LINE_GCODE && words.got_n_word) {
+    gc.line_number = words.n;
+  } else {
+    gc.line_number++;
+  }
+  planner_set_line_number(gc.line_number);
  //// process line
-  if (strlen(rx_line) > 0) {          // Line is complete. Then execute!
+  if (line_type != LINE_EMPTY) {  // Line is complete. Then execute!
     // handle position update after a stop
     if (position_update_requested) {
-      gc.position[X_AXIS] = stepper_get_position_x();
-      gc.position[Y_AXIS] = stepper_get_position_y();
-      gc.position[Z_AXIS] = stepper_get_position_z();
+      stepper_get_position(gc.position);
       position_update_requested = false;
       //printString("gcode pos update\n");  // debug
     }
     
     if (stepper_stop_requested()) {
       status_code = stepper_stop_status();
-    } else if (rx_line[0] == '$') {
+    } else if (line_type == LINE_BINARY) {
+      status_code = binary_execute_frame(rx_frame, rx_frame_length);
+      // binary moves bypass the parser, take over where they ended
+      planner_get_position(gc.position);
+      gc.position[X_AXIS] -= gc.offsets[3*gc.offselect+X_AXIS];
+      gc.position[Y_AXIS] -= gc.offsets[3*gc.offselect+Y_AXIS];
+      gc.position[Z_AXIS] -= gc.offsets[3*gc.offselect+Z_AXIS];
+    } else if (line_type == LINE_DOLLAR) {
       printPgmString(PSTR("\nLasaurGrbl " LASAURGRBL_VERSION));
       printPgmString(PSTR("\nSee config.h for configuration.\n"));
       status_code = STATUS_OK;
-    } else if (rx_line[0] == '?') {
-      printString("X");
-      printFloat(stepper_get_position_x());
-      printString(" Y");
-      printFloat(stepper_get_position_y());
-      printString("\n");
-      status_code = STATUS_OK;
     } else {
       // process gcode
-      status_code = gcode_execute_line(rx_line);
+      status_code = execute_words();
     }    
   } else { 
     // empty or comment line, send ok for consistency
@@ -185,6 +325,7 @@ void gcode_process_line() {
   }
   
   //// return status
+  trace_event(TRACE_LINE_DONE, status_code);
   if (status_code == STATUS_OK) {
     printPgmString(PSTR("ok\n"));
   } else {
@@ -203,6 +344,12 @@ void gcode_process_line() {
         printPgmString(PSTR("Error: Chiller Off\n")); break;
       case STATUS_STOP_LIMIT_HIT:
         printPgmString(PSTR("Error: Limit Hit\n")); break;                    
+      case STATUS_BINARY_CRC:
+        printPgmString(PSTR("Error: Binary CRC\n")); break;
+      case STATUS_BINARY_SEQUENCE:
+        printPgmString(PSTR("Error: Binary sequence\n")); break;
+      case STATUS_BINARY_FRAME:
+        printPgmString(PSTR("Error: Binary frame\n")); break;
       default:
         printPgmString(PSTR("Error: "));
         printInteger(status_code);
@@ -212,105 +359,224 @@ void gcode_process_line() {
 }
 
 
-
 // Executes one line of 0-terminated G-Code. The line is assumed to contain only uppercase
 // characters and signed floating point values (no whitespace). Comments and block delete
 // characters have been removed.
 uint8_t gcode_execute_line(char *line) {
-  uint8_t char_counter = 0;  
-  char letter;
+  words_begin();
+  while (*line) {
+    words_feed(*line++);
+  }
+  words_end();
+  return execute_words();
+}
+
+
+// Start recording the words of a new line
+static void words_begin() {
+  memset(&words, 0, sizeof(words));
+  words.motion_mode = -1;
+  words.inches_mode = -1;
+  words.absolute_mode = -1;
+  words.offselect = -1;
+  words.path_mode = -1;
+  words.next_action = NEXT_ACTION_NONE;
+  gc.status_code = STATUS_OK;
+}
+
+
+// Feed the next character of a line, words are recorded as soon as they are complete.
+// After an error the rest of the line is ignored.
+static void words_feed(char c) {
+  if (gc.status_code) { return; }
+  if (words.letter != 0) {
+    if (number_feed(&words.number, c)) { return; }
+    complete_word();
+    if (gc.status_code) { return; }
+  }
+  if ((c < 'A') || (c > 'Z')) {
+    FAIL(STATUS_EXPECTED_COMMAND_LETTER);
+    return;
+  }
+  words.letter = c;
+  number_begin(&words.number);
+}
+
+
+// End of line, the last word is complete
+static void words_end() {
+  if (words.letter != 0 && !gc.status_code) {
+    complete_word();
+  }
+}
+
+
+static void complete_word() {
   double value;
   int int_value;
+  if (!number_value(&words.number, &value)) {
+    FAIL(STATUS_BAD_NUMBER_FORMAT); 
+    return;
+  }
+  switch(words.letter) {
+    case 'G':
+      int_value = trunc(value);
+      switch(int_value) {
+        case 0: words.motion_mode = words.next_action = NEXT_ACTION_SEEK; break;
+        case 1: words.motion_mode = words.next_action = NEXT_ACTION_FEED; break;
+        case 2: words.motion_mode = words.next_action = NEXT_ACTION_ARC_CW; break;
+        case 3: words.motion_mode = words.next_action = NEXT_ACTION_ARC_CCW; break;
+        case 5: words.motion_mode = words.next_action = NEXT_ACTION_SPLINE; break;
+        case 4: words.next_action = NEXT_ACTION_DWELL; break;
+        case 10: words.next_action = NEXT_ACTION_SET_COORDINATE_OFFSET; break;
+        case 20: words.inches_mode = true; break;
+        case 21: words.inches_mode = false; break;
+        case 30: words.next_action = NEXT_ACTION_HOMING_CYCLE; break;
+        case 54: words.offselect = OFFSET_G54; break;
+        case 55: words.offselect = OFFSET_G55; break;
+        case 61: words.path_mode = PATH_EXACT; break;
+        case 64: words.path_mode = PATH_BLENDING; break;
+        case 90: words.absolute_mode = true; break;
+        case 91: words.absolute_mode = false; break;
+        default: FAIL(STATUS_UNSUPPORTED_STATEMENT);
+      }
+      break;
+    case 'M':
+      int_value = trunc(value);
+      switch(int_value) {
+        case 7: words.next_action = NEXT_ACTION_AIR_ENABLE;break;
+        case 8: words.next_action = NEXT_ACTION_GAS_ENABLE;break;
+        case 9: words.next_action = NEXT_ACTION_AIRGAS_DISABLE;break;
+        default: FAIL(STATUS_UNSUPPORTED_STATEMENT);
+      }            
+      break;
+    case 'F':
+      words.feed_word = value;
+      words.got_feed_word = true;
+      break;
+    case 'X': case 'Y': case 'Z':
+      words.axis_words[words.letter - 'X'] = value;
+      words.axis_mask |= (1 << (words.letter - 'X'));
+      break;        
+    case 'I': case 'J': case 'K':
+      words.arc_offset[words.letter - 'I'] = value;
+      words.arc_offset_mask |= (1 << (words.letter - 'I'));
+      break;
+    case 'R':
+      words.r_word = value;
+      words.got_r_word = true;
+      break;
+    case 'P':  // dwelling seconds, CS selector or G5 control point X
+      words.p = value;
+      words.got_p_word = true;
+      break;
+    case 'Q':  // G5 control point Y
+      words.q = value;
+      words.got_q_word = true;
+      break;
+    case 'S':
+      words.s_word = value;
+      words.got_s_word = true;
+      break; 
+    case 'L':  // G10 qualifier 
+      words.l = trunc(value);
+      break;
+    case 'N':
+      words.n = value < 0 ? 0 : value;
+      words.got_n_word = true;
+      break;
+  }
+  words.letter = 0;
+}
+
+
+// Execute the recorded words of a line. Modal commands take effect first,
+// then the parameters. When a word is repeated the last one counts.
+static uint8_t execute_words() {
+  int axis;
   double unit_converted_value;  
-  uint8_t next_action = NEXT_ACTION_NONE;
+  uint8_t next_action = words.next_action;
   double target[3];
-  double p = 0.0;
+  double offset[3];
+  double control_1[2], control_2[2];
+  double x, y, h_x2_div_d;
+  double p = words.p;
   int cs = 0;
-  int l = 0;
+  int l = words.l;
   bool got_actual_line_command = false;  // as opposed to just e.g. G1 F1200
-  gc.status_code = STATUS_OK;
-    
-  //// Pass 1: Commands
-  while(next_statement(&letter, &value, line, &char_counter)) {
-    int_value = trunc(value);
-    switch(letter) {
-      case 'G':
-        switch(int_value) {
-          case 0: gc.motion_mode = next_action = NEXT_ACTION_SEEK; break;
-          case 1: gc.motion_mode = next_action = NEXT_ACTION_FEED; break;
-          case 4: next_action = NEXT_ACTION_DWELL; break;
-          case 10: next_action = NEXT_ACTION_SET_COORDINATE_OFFSET; break;
-          case 20: gc.inches_mode = true; break;
-          case 21: gc.inches_mode = false; break;
-          case 30: next_action = NEXT_ACTION_HOMING_CYCLE; break;
-          case 54: gc.offselect = OFFSET_G54; break;
-          case 55: gc.offselect = OFFSET_G55; break;
-          case 90: gc.absolute_mode = true; break;
-          case 91: gc.absolute_mode = false; break;
-          default: FAIL(STATUS_UNSUPPORTED_STATEMENT);
-        }
-        break;
-      case 'M':
-        switch(int_value) {
-          case 7: next_action = NEXT_ACTION_AIR_ENABLE;break;
-          case 8: next_action = NEXT_ACTION_GAS_ENABLE;break;
-          case 9: next_action = NEXT_ACTION_AIRGAS_DISABLE;break;
-          default: FAIL(STATUS_UNSUPPORTED_STATEMENT);
-        }            
-        break;
-    }
-    if (gc.status_code) { break; }
-  }
   
   // bail when errors
   if (gc.status_code) { return gc.status_code; }
 
-  char_counter = 0;
-  memcpy(target, gc.position, sizeof(target)); // i.e. target = gc.position
+  //// Modal commands
+  if (words.motion_mode >= 0) { gc.motion_mode = words.motion_mode; }
+  if (words.inches_mode >= 0) { gc.inches_mode = words.inches_mode; }
+  if (words.absolute_mode >= 0) { gc.absolute_mode = words.absolute_mode; }
+  if (words.offselect >= 0) { gc.offselect = words.offselect; }
 
-  //// Pass 2: Parameters
-  while(next_statement(&letter, &value, line, &char_counter)) {
+  //// Parameters
+  if (words.got_feed_word) {
     if (gc.inches_mode) {
-      unit_converted_value = value * MM_PER_INCH;
+      unit_converted_value = words.feed_word * MM_PER_INCH;
     } else {
-      unit_converted_value = value;
+      unit_converted_value = words.feed_word;
     }
-    switch(letter) {
-      case 'F':
-        if (unit_converted_value <= 0) { FAIL(STATUS_BAD_NUMBER_FORMAT); }
-        if (gc.motion_mode == NEXT_ACTION_SEEK) {
-          gc.seek_rate = unit_converted_value;
-        } else {
-          gc.feed_rate = unit_converted_value;
-        }
-        break;
-      case 'X': case 'Y': case 'Z':
-        if (gc.absolute_mode) {
-          target[letter - 'X'] = unit_converted_value;
-        } else {
-          target[letter - 'X'] += unit_converted_value;
-        }
-        got_actual_line_command = true;
-        break;        
-      case 'P':  // dwelling seconds or CS selector
-        if (next_action == NEXT_ACTION_SET_COORDINATE_OFFSET) {
-          cs = trunc(value);
-        } else {
-          p = value;
-        }
-        break;
-      case 'S':
-        gc.nominal_laser_intensity = value;
-        break; 
-      case 'L':  // G10 qualifier 
-      l = trunc(value);
-        break;
+    if (unit_converted_value <= 0) { FAIL(STATUS_BAD_NUMBER_FORMAT); }
+    if (gc.motion_mode == NEXT_ACTION_SEEK) {
+      gc.seek_rate = unit_converted_value;
+    } else {
+      gc.feed_rate = unit_converted_value;
     }
   }
+  memcpy(target, gc.position, sizeof(target)); // i.e. target = gc.position
+  for (axis = X_AXIS; axis <= Z_AXIS; axis++) {
+    if (words.axis_mask & (1 << axis)) {
+      if (gc.inches_mode) {
+        unit_converted_value = words.axis_words[axis] * MM_PER_INCH;
+      } else {
+        unit_converted_value = words.axis_words[axis];
+      }
+      if (gc.absolute_mode) {
+        target[axis] = unit_converted_value;
+      } else {
+        target[axis] += unit_converted_value;
+      }
+      got_actual_line_command = true;
+    }
+  }
+  if (next_action == NEXT_ACTION_SET_COORDINATE_OFFSET) {
+    cs = trunc(p);
+  }
+  for (axis = X_AXIS; axis <= Z_AXIS; axis++) {
+    if (gc.inches_mode) {
+      offset[axis] = words.arc_offset[axis] * MM_PER_INCH;
+    } else {
+      offset[axis] = words.arc_offset[axis];
+    }
+  }
+  if (words.got_s_word) {
+    gc.nominal_laser_intensity = words.s_word;
+  }
   
   // bail when error
   if (gc.status_code) { return(gc.status_code); }
       
+  //// Path control mode, P is the tolerance with G64
+  if (words.path_mode >= 0) {
+    if (words.path_mode == PATH_EXACT) {
+      unit_converted_value = 0.0;
+    } else if (words.got_p_word) {
+      unit_converted_value = gc.inches_mode ? p * MM_PER_INCH : p;
+      if (unit_converted_value < 0) { FAIL(STATUS_BAD_NUMBER_FORMAT); return(gc.status_code); }
+    } else {
+      unit_converted_value = CONFIG_BLEND_TOLERANCE;
+    }
+    if (unit_converted_value != gc.blend_tolerance) {
+      gc.blend_tolerance = unit_converted_value;
+      planner_set_blend_tolerance(gc.blend_tolerance);
+    }
+  }
+
   //// Perform any physical actions
   switch (next_action) {
     case NEXT_ACTION_SEEK:
@@ -329,6 +595,55 @@ uint8_t gcode_execute_line(char *line) {
                       gc.feed_rate, gc.nominal_laser_intensity );                   
       }
       break; 
+    case NEXT_ACTION_ARC_CW: case NEXT_ACTION_ARC_CCW:
+      if (!got_actual_line_command) { break; }
+      if (!words.got_r_word && !words.arc_offset_mask) {
+        // neither a radius nor a center, grbl rejects these too
+        FAIL(STATUS_UNSUPPORTED_STATEMENT);
+        return(gc.status_code);
+      }
+      if (words.got_r_word) {
+        // Find the center from the radius, see the NIST RS274/NGC Interpreter.
+        // The center lies on the perpendicular bisector of the chord, at h_x2_div_d
+        // times half the chord length. A negative radius picks the arc over 180°.
+        unit_converted_value = gc.inches_mode ? words.r_word * MM_PER_INCH : words.r_word;
+        x = target[X_AXIS] - gc.position[X_AXIS];
+        y = target[Y_AXIS] - gc.position[Y_AXIS];
+        h_x2_div_d = 4 * unit_converted_value*unit_converted_value - x*x - y*y;
+        if (h_x2_div_d < 0 || (x == 0 && y == 0)) { 
+          FAIL(STATUS_FLOATING_POINT_ERROR);  // no such arc, or a full circle
+          return(gc.status_code); 
+        }
+        h_x2_div_d = -sqrt(h_x2_div_d)/hypot(x,y);
+        if (next_action == NEXT_ACTION_ARC_CCW) { h_x2_div_d = -h_x2_div_d; }
+        if (unit_converted_value < 0) { h_x2_div_d = -h_x2_div_d; }
+        offset[X_AXIS] = 0.5*(x-(y*h_x2_div_d));
+        offset[Y_AXIS] = 0.5*(y+(x*h_x2_div_d));
+      }
+      trace_arc(gc.position, target, offset, next_action == NEXT_ACTION_ARC_CW);
+      break;
+    case NEXT_ACTION_SPLINE:
+      if (!got_actual_line_command) { break; }
+      // G5 X Y I J P Q: I J is the first control point relative to the start, P Q the second
+      // relative to the end. Following a G5, I and J default to the mirror of its P Q.
+      if (!words.got_p_word || !words.got_q_word || 
+          (!(words.arc_offset_mask & 3) && !gc.spline_continues)) {
+        FAIL(STATUS_UNSUPPORTED_STATEMENT);
+        return(gc.status_code);
+      }
+      if (words.arc_offset_mask & 3) {
+        control_1[X_AXIS] = gc.position[X_AXIS] + offset[X_AXIS];
+        control_1[Y_AXIS] = gc.position[Y_AXIS] + offset[Y_AXIS];
+      } else {
+        control_1[X_AXIS] = gc.position[X_AXIS] - gc.spline_control[X_AXIS];
+        control_1[Y_AXIS] = gc.position[Y_AXIS] - gc.spline_control[Y_AXIS];
+      }
+      gc.spline_control[X_AXIS] = gc.inches_mode ? words.p * MM_PER_INCH : words.p;
+      gc.spline_control[Y_AXIS] = gc.inches_mode ? words.q * MM_PER_INCH : words.q;
+      control_2[X_AXIS] = target[X_AXIS] + gc.spline_control[X_AXIS];
+      control_2[Y_AXIS] = target[Y_AXIS] + gc.spline_control[Y_AXIS];
+      trace_spline(gc.position, target, control_1, control_2);
+      break;
     case NEXT_ACTION_DWELL:
       planner_dwell(p, gc.nominal_laser_intensity);
       break;
@@ -398,6 +713,12 @@ uint8_t gcode_execute_line(char *line) {
       break;
   }
   
+  if (got_actual_line_command && next_action != NEXT_ACTION_SPLINE) {
+    gc.spline_continues = false;
+  } else if (next_action == NEXT_ACTION_SPLINE) {
+    gc.spline_continues = true;
+  }
+
   // As far as the parser is concerned, the position is now == target. In reality the
   // motion control system might still be processing the action and the real tool position
   // in any intermediate location.
@@ -406,53 +727,346 @@ uint8_t gcode_execute_line(char *line) {
 }
 
 
+// Trace an arc in the XY plane from position to target as a series of lines, Z moves
+// linearly along (helix). Offset is the vector from position to the center. The segment
+// angle keeps the chord within CONFIG_ARC_TOLERANCE of the arc. The radius vector is
+// rotated by that angle with a rotation matrix computed once, rounding errors of the
+// repeated rotation are removed with an exact sin/cos every ARC_CORRECTION segments.
+static void trace_arc(double *position, double *target, double *offset, bool isclockwise) {
+  double center_x = position[X_AXIS] + offset[X_AXIS];
+  double center_y = position[Y_AXIS] + offset[Y_AXIS];
+  double r_x = -offset[X_AXIS];  // radius vector from the center to the current point
+  double r_y = -offset[Y_AXIS];
+  double rt_x = target[X_AXIS] - center_x;  // radius vector to the target
+  double rt_y = target[Y_AXIS] - center_y;
+  double radius = hypot(r_x, r_y);
+  double linear_travel = target[Z_AXIS] - position[Z_AXIS];
+  double angular_travel, segment_angle, millimeters, min_length;
+  double cos_t, sin_t, r_tmp, z;
+  uint16_t segments, i;
+  uint8_t count = 0;
+
+  // ccw angle between the radius vectors, then take it the right way round.
+  // The same start and end point is a full circle.
+  angular_travel = atan2(r_x*rt_y - r_y*rt_x, r_x*rt_x + r_y*rt_y);
+  if (isclockwise) {
+    if (angular_travel >= -ARC_ANGULAR_TRAVEL_EPSILON) { angular_travel -= 2*M_PI; }
+  } else {
+    if (angular_travel <= ARC_ANGULAR_TRAVEL_EPSILON) { angular_travel += 2*M_PI; }
+  }
+
+  // chord deviation e = r*(1-cos(a/2)), so the largest segment angle is 2*acos(1-e/r)
+  if (radius > CONFIG_ARC_TOLERANCE) {
+    segment_angle = 2*acos(1 - CONFIG_ARC_TOLERANCE/radius);
+    segments = min(ceil(fabs(angular_travel)/segment_angle), ARC_SEGMENTS_MAX);
+  } else {
+    segments = 1;
+  }
+  // no segment shorter than what the planner gets through at this feed
+  millimeters = hypot(angular_travel*radius, linear_travel);
+  min_length = gc.feed_rate * planner_get_feed_override()/100.0 / 60.0 * CONFIG_ARC_SEGMENT_TIME;
+  if (segments > 1 && millimeters < segments*min_length) {
+    segments = max(floor(millimeters/min_length), 1);
+  }
+
+  segment_angle = angular_travel/segments;
+  cos_t = cos(segment_angle);
+  sin_t = sin(segment_angle);
+  z = position[Z_AXIS];
+  for (i = 1; i < segments; i++) {
+    if (count < ARC_CORRECTION) {
+      r_tmp = r_x*cos_t - r_y*sin_t;
+      r_y = r_x*sin_t + r_y*cos_t;
+      r_x = r_tmp;
+      count++;
+    } else {
+      r_x = -offset[X_AXIS]*cos(i*segment_angle) + offset[Y_AXIS]*sin(i*segment_angle);
+      r_y = -offset[X_AXIS]*sin(i*segment_angle) - offset[Y_AXIS]*cos(i*segment_angle);
+      count = 0;
+    }
+    z += linear_travel/segments;
+    planner_line( center_x + r_x + gc.offsets[3*gc.offselect+X_AXIS], 
+                  center_y + r_y + gc.offsets[3*gc.offselect+Y_AXIS], 
+                  z + gc.offsets[3*gc.offselect+Z_AXIS], 
+                  gc.feed_rate, gc.nominal_laser_intensity );
+  }
+  // the last segment ends exactly on target
+  planner_line( target[X_AXIS] + gc.offsets[3*gc.offselect+X_AXIS], 
+                target[Y_AXIS] + gc.offsets[3*gc.offselect+Y_AXIS], 
+                target[Z_AXIS] + gc.offsets[3*gc.offselect+Z_AXIS], 
+                gc.feed_rate, gc.nominal_laser_intensity );
+}
+
+
+// Trace a cubic Bezier curve in the XY plane from position to target, Z moves linearly
+// along. The curve is split in halves (de Casteljau) until the control points are within
+// CONFIG_SPLINE_TOLERANCE of the chord, the curve lies in their hull so the chord is too.
+// Pieces shorter than CONFIG_ARC_SEGMENT_TIME at the current feed are not split further.
+// Halves still to be traced wait on a stack, at most SPLINE_DEPTH_MAX of them, and each
+// flat piece goes to the planner as soon as it is found.
+static void trace_spline(double *position, double *target, double *control_1, double *control_2) {
+  typedef struct {
+    double x[4], y[4];  // control points
+    double t;           // curve parameter at the end point
+    uint8_t depth;      // the piece spans 1/2^depth of the curve
+  } piece_t;
+  piece_t stack[SPLINE_DEPTH_MAX];
+  uint8_t top = 0;
+  piece_t piece, *right;
+  double chord_x, chord_y, chord, deviation, length, min_length;
+  double x12, y12;
+  uint8_t i;
+
+  piece.x[0] = position[X_AXIS]; piece.y[0] = position[Y_AXIS];
+  piece.x[1] = control_1[X_AXIS]; piece.y[1] = control_1[Y_AXIS];
+  piece.x[2] = control_2[X_AXIS]; piece.y[2] = control_2[Y_AXIS];
+  piece.x[3] = target[X_AXIS]; piece.y[3] = target[Y_AXIS];
+  piece.t = 1.0;
+  piece.depth = 0;
+  min_length = gc.feed_rate * planner_get_feed_override()/100.0 / 60.0 * CONFIG_ARC_SEGMENT_TIME;
+
+  while (1) {
+    // distance of the inner control points from the chord, or from the start if it is closed
+    chord_x = piece.x[3] - piece.x[0];
+    chord_y = piece.y[3] - piece.y[0];
+    chord = hypot(chord_x, chord_y);
+    deviation = 0;
+    length = 0;
+    for (i = 1; i <= 2; i++) {
+      if (chord > CONFIG_SPLINE_TOLERANCE) {
+        deviation = max(deviation, fabs((piece.x[i]-piece.x[0])*chord_y - (piece.y[i]-piece.y[0])*chord_x) / chord);
+      } else {
+        deviation = max(deviation, hypot(piece.x[i]-piece.x[0], piece.y[i]-piece.y[0]));
+      }
+      length += hypot(piece.x[i]-piece.x[i-1], piece.y[i]-piece.y[i-1]);
+    }
+    length += hypot(piece.x[3]-piece.x[2], piece.y[3]-piece.y[2]);
+
+    if (deviation > CONFIG_SPLINE_TOLERANCE && length > min_length && piece.depth < SPLINE_DEPTH_MAX) {
+      // split at t=0.5, keep the left half and stack the right one
+      right = &stack[top++];
+      x12 = (piece.x[1] + piece.x[2])/2;
+      y12 = (piece.y[1] + piece.y[2])/2;
+      right->x[3] = piece.x[3];
+      right->y[3] = piece.y[3];
+      right->x[2] = (piece.x[2] + piece.x[3])/2;
+      right->y[2] = (piece.y[2] + piece.y[3])/2;
+      right->x[1] = (x12 + right->x[2])/2;
+      right->y[1] = (y12 + right->y[2])/2;
+      piece.x[1] = (piece.x[0] + piece.x[1])/2;
+      piece.y[1] = (piece.y[0] + piece.y[1])/2;
+      piece.x[2] = (piece.x[1] + x12)/2;
+      piece.y[2] = (piece.y[1] + y12)/2;
+      piece.x[3] = right->x[0] = (piece.x[2] + right->x[1])/2;
+      piece.y[3] = right->y[0] = (piece.y[2] + right->y[1])/2;
+      right->t = piece.t;
+      piece.depth++;
+      right->depth = piece.depth;
+      piece.t -= 1.0/(1UL << piece.depth);
+      continue;
+    }
+
+    planner_line( piece.x[3] + gc.offsets[3*gc.offselect+X_AXIS], 
+                  piece.y[3] + gc.offsets[3*gc.offselect+Y_AXIS], 
+                  position[Z_AXIS] + (target[Z_AXIS]-position[Z_AXIS])*piece.t + gc.offsets[3*gc.offselect+Z_AXIS], 
+                  gc.feed_rate, gc.nominal_laser_intensity );
+    if (top == 0) { break; }
+    piece = stack[--top];
+  }
+}
+
+
 void gcode_request_position_update() {
   position_update_requested = true;
 }
 
 
-// Parses the next statement and leaves the counter on the first character following
-// the statement. Returns 1 if there was a statements, 0 if end of string was reached
-// or there was an error (check state.status_code).
-static int next_statement(char *letter, double *double_ptr, char *line, uint8_t *char_counter) {
-  if (line[*char_counter] == 0) {
-    return(0); // No more statements
+// Real-time commands are single characters that never enter the line buffer.
+// This is called from the receive path and only flags or requests the action
+// so it is safe from any context. Holds and stops are acted on by the stepper
+// interrupt, everything else on the next gcode_execute_runtime().
+bool gcode_runtime_command(uint8_t c) {
+  switch(c) {
+    case CHAR_STATUS:
+      status_report_requested = true;
+      return true;
+    case CHAR_FEED_HOLD:
+      stepper_request_hold();
+      return true;
+    case CHAR_RESUME:
+      resume_requested = true;
+      return true;
+    case CHAR_RESET:
+      stepper_request_stop(STATUS_STOP_SERIAL_REQUEST);
+      reset_requested = true;
+      return true;
+    case CHAR_FEED_OVR_RESET:
+      feed_override = 100;
+      return true;
+    case CHAR_FEED_OVR_PLUS_10:
+      gcode_request_feed_override(feed_override + 10);
+      return true;
+    case CHAR_FEED_OVR_MINUS_10:
+      gcode_request_feed_override(feed_override - 10);
+      return true;
+    case CHAR_FEED_OVR_PLUS_1:
+      gcode_request_feed_override(feed_override + 1);
+      return true;
+    case CHAR_FEED_OVR_MINUS_1:
+      gcode_request_feed_override(feed_override - 1);
+      return true;
   }
-  
-  *letter = line[*char_counter];
-  if((*letter < 'A') || (*letter > 'Z')) {
-    FAIL(STATUS_EXPECTED_COMMAND_LETTER);
-    return(0);
+  return false;
+}
+
+
+void gcode_request_feed_override(int percent) {
+  if (percent < FEED_OVERRIDE_MIN) { percent = FEED_OVERRIDE_MIN; }
+  if (percent > FEED_OVERRIDE_MAX) { percent = FEED_OVERRIDE_MAX; }
+  feed_override = percent;
+}
+
+uint8_t gcode_get_feed_override() {
+  return feed_override;
+}
+
+
+// Called from the grbl task wherever it waits, eg: for serial data
+// or for room in the block buffer. The reset itself is completed
+// in protocol_process() because it has to discard the partial line.
+void gcode_execute_runtime() {
+  if (resume_requested) {
+    resume_requested = false;
+    stepper_resume();  // replans the buffer when holding
+  }
+  if (feed_override != planner_get_feed_override()) {
+    planner_set_feed_override(feed_override);
+  }
+  if (status_report_requested) {
+    isr_timing_t isr_execution, isr_latency;
+    uint32_t stack_free, heap_free;
+    double *offset = &gc.offsets[3*gc.offselect];
+    double position[3];
+    stepper_get_position(position);
+    status_report_requested = false;
+    switch(stepper_get_state()) {
+      case STEPPER_RUNNING: printString("Run"); break;
+      case STEPPER_HOLDING: printString("Hold"); break;
+      case STEPPER_STOPPED: printString("Stop"); break;
+      default: printString("Idle");
+    }
+    printString(" MPos:");
+    print_axes(position[X_AXIS], position[Y_AXIS], position[Z_AXIS]);
+    printString(" WPos:");
+    print_axes(position[X_AXIS] - offset[X_AXIS], position[Y_AXIS] - offset[Y_AXIS],
+               position[Z_AXIS] - offset[Z_AXIS]);
+    printString(" blocks:");
+    printInteger(planner_blocks_queued());
+    printString(" rx:");
+    printInteger(serial_available());
+    printString(" F:");
+    printInteger(lround(stepper_get_feed_rate()));
+    printString(" S:");
+    printInteger(control_get_laser_intensity());
+    printString(" line:");
+    printInteger(stepper_get_line_number());
+    printString(" starved:");
+    printInteger(stepper_get_starvation_count());
+    printString(" overrun:");
+    printInteger(serial_get_overrun_count());
+    stepper_get_isr_timing(&isr_execution, &isr_latency);
+    printString(" isr:");
+    printInteger(isr_execution.max/1000);
+    printString("/");
+    printInteger(isr_latency.max/1000);
+    if (dev_memory_headroom(&stack_free, &heap_free)) {
+      printString(" mem:");
+      printInteger(stack_free);
+      printString("/");
+      printInteger(heap_free);
+    }
+    printString("\n");
   }
-  (*char_counter)++;
-  if (!read_double(line, char_counter, double_ptr)) {
-    FAIL(STATUS_BAD_NUMBER_FORMAT); 
-    return(0);
-  };
-  return(1);
 }
 
 
-// Read a floating point value from a string. Line points to the input buffer, char_counter 
-// is the indexer pointing to the current character of the line, while double_ptr is 
-// a pointer to the result variable. Returns true when it succeeds
-static int read_double(char *line, uint8_t *char_counter, double *double_ptr) {
-  char *start = line + *char_counter;
-  char *end;
-  
-  *double_ptr = strtod(start, &end);
-  if(end == start) { 
-    return(false); 
-  };
+// The push task calls this besides the grbl task, it only reads what the
+// stepper and planner publish for other tasks anyway.
+void gcode_status_frame(char *frame) {
+  static const char states[] = "IRHS";  // by STEPPER_IDLE..STEPPER_STOPPED
+  stepper_snapshot_t snapshot;
+  stepper_get_snapshot(&snapshot);
+  snprintf(frame, STATUS_FRAME_SIZE, "@%c,%ld,%ld,%ld,%u,%ld,%lu\n", states[stepper_get_state()],
+           (long)snapshot.steps[X_AXIS], (long)snapshot.steps[Y_AXIS], (long)snapshot.steps[Z_AXIS],
+           planner_blocks_queued(), lround(stepper_get_feed_rate()),
+           (unsigned long)stepper_get_line_number());
+}
 
-  *char_counter = end - line;
+
+static void print_axes(double x, double y, double z) {
+  printFloat(x);
+  printString(",");
+  printFloat(y);
+  printString(",");
+  printFloat(z);
+}
+
+
+static void number_begin(number_reader_t *number) {
+  memset(number, 0, sizeof(number_reader_t));
+  number->exact = true;
+}
+
+
+// Feed the next character of a number. Returns false when the character does not
+// belong to it, the number is then complete. Only plain decimals are accepted.
+// Unlike strtod() exponents and hex are not, their letters are g-code words
+// (eg: "G0X10" is G0 X10, not G16).
+static bool number_feed(number_reader_t *number, char c) {
+  if (c >= '0' && c <= '9') {
+    if (number->mantissa > (EXACT_MANTISSA_MAX - 9)/10) { number->exact = false; }
+    else { number->mantissa = number->mantissa*10 + (c - '0'); }
+    if (number->isdecimal && number->decimals < 255) { number->decimals++; }
+    if (number->digits < 255) { number->digits++; }
+  } else if (c == '.' && !number->isdecimal) {
+    number->isdecimal = true;
+  } else if ((c == '-' || c == '+') && number->length == 0) {
+    number->negative = (c == '-');
+  } else {
+    return(false);
+  }
+  if (number->length < NUMBER_TOKEN_SIZE) {
+    number->token[number->length++] = c;
+  }
+  return(true);
+}
+
+
+// Value of a complete number. Returns true when it succeeds.
+static bool number_value(number_reader_t *number, double *double_ptr) {
+  if (number->digits == 0) { 
+    return(false); 
+  }
+#ifdef GCODE_STRTOD
+  number->exact = false;  // reference build for tools/gcode_bench.c
+#endif
+  if (number->exact && number->decimals <= EXACT_DECIMALS_MAX) {
+    *double_ptr = number->mantissa / powers_of_ten[number->decimals];
+    if (number->negative) { *double_ptr = -*double_ptr; }
+  } else {
+    if (number->length == NUMBER_TOKEN_SIZE) {
+      return(false);  // too long to keep
+    }
+    number->token[number->length] = 0;
+    *double_ptr = strtod(number->token, NULL);
+  }
   return(true);
 }
 
 /* 
   Intentionally not supported:
 
-  - arcs {G2, G3}
+  - arcs outside the XY plane {G18, G19}
   - Canned cycles
   - Tool radius compensation
   - A,B,C-axes
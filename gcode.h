@@ -23,6 +23,7 @@
 #define gcode_h
 
 #include "stdint.h"
+#include <stdbool.h>
 
 #define STATUS_OK 0
 #define STATUS_BAD_NUMBER_FORMAT 1
@@ -33,6 +34,9 @@
 #define STATUS_STOP_POWER_OFF 6
 #define STATUS_STOP_CHILLER_OFF 7
 #define STATUS_STOP_LIMIT_HIT 8
+#define STATUS_BINARY_CRC 9
+#define STATUS_BINARY_SEQUENCE 10
+#define STATUS_BINARY_FRAME 11
 
 
 // Initialize the parser
@@ -48,4 +52,23 @@ uint8_t gcode_execute_line(char *line);
 // called from the stepper code that executes the stop
 void gcode_request_position_update();
 
+// Intercept real-time command characters in the receive path.
+// Returns true if the character was consumed and must not enter the line buffer.
+bool gcode_runtime_command(uint8_t c);
+
+// Act on pending real-time commands, called wherever grbl waits
+void gcode_execute_runtime();
+
+// One short line for the status push: state, position in steps, blocks,
+// feed and line number, eg: "@R,4026,2013,0,16,3000,208\n"
+#define STATUS_FRAME_SIZE 64
+void gcode_status_frame(char *frame);
+
+// Request a new feed override in percent, clamped to FEED_OVERRIDE_MIN..MAX.
+// Applied to all buffered blocks on the next gcode_execute_runtime().
+void gcode_request_feed_override(int percent);
+
+// The feed override last requested, in percent.
+uint8_t gcode_get_feed_override();
+
 #endif
@@ -24,7 +24,9 @@
 #include <string.h>
 #include "planner.h"
 #include "stepper.h"
+#include "gcode.h"
 #include "config.h"
+#include "trace.h"
 
 
 // The number of linear motions that can be in the plan at any give time
@@ -38,6 +40,23 @@ static int32_t position[3];             // The current position of the tool in a
 static volatile bool position_update_requested;  // make sure to update to stepper position on next occasion
 static double previous_unit_vec[3];     // Unit vector of previous path line segment
 static double previous_nominal_speed;   // Nominal speed of previous path line segment
+static double previous_millimeters;     // Length of previous path line segment
+static double blend_tolerance;          // G64 path tolerance in mm, 0 for the exact path (G61)
+static uint8_t feed_override;           // Percentage applied to the feed rate of every block
+
+// Producer side, owned by the parser. With PLANNER_TASK the planner lags behind by
+// the commands still in the queue so the parser keeps its own end position.
+static int32_t queued_position[3];      // Target of the last queued line in absolute steps
+static uint32_t queued_line_number;     // g-code line of the commands queued now
+static uint32_t planning_line_number;   // g-code line of the command being planned
+static volatile bool queued_position_update_requested;  // take over the stepper position after a stop
+
+#ifndef PLANNER_TASK
+// Without a planner task commands are planned right away
+#define planner_queue(command) planner_execute(command)
+#define planner_lock()
+#define planner_unlock()
+#endif
 
 // prototypes for static functions (non-accesible from other files)
 static int8_t next_block_index(int8_t block_index);
@@ -46,9 +65,16 @@ static double estimate_acceleration_distance(double initial_rate, double target_
 static double intersection_distance(double initial_rate, double final_rate, double acceleration, double distance);
 static double max_allowable_speed(double acceleration, double target_velocity, double distance);
 static void calculate_trapezoid_for_block(block_t *block, double entry_factor, double exit_factor);
+static void initialize_entry_speed(block_t *block);
 static void reduce_entry_speed_reverse(block_t *current, block_t *next);
 static void reduce_entry_speed_forward(block_t *previous, block_t *current);
 static void planner_recalculate();
+static void plan_line_steps(int32_t *target, double feed_rate, uint8_t nominal_laser_intensity);
+static void plan_command(uint8_t type);
+static int8_t wait_for_free_block();
+static void update_queued_position();
+static void queue_line(double feed_rate, uint8_t nominal_laser_intensity);
+static double buffered_minutes();
 
 
 
@@ -57,8 +83,13 @@ void planner_init() {
   block_buffer_tail = 0;
   clear_vector(position);
   position_update_requested = false;
+  clear_vector(queued_position);
+  queued_position_update_requested = false;
   clear_vector_double(previous_unit_vec);
   previous_nominal_speed = 0.0;
+  previous_millimeters = 0.0;
+  blend_tolerance = 0.0;
+  feed_override = 100;
 }
 
 
@@ -67,21 +98,96 @@ void planner_init() {
 // the signed, absolute target position in millimeters. Feed rate specifies the speed of the motion.
 void planner_line(double x, double y, double z, double feed_rate, uint8_t nominal_laser_intensity) {    
   // calculate target position in absolute steps
-  int32_t target[3];
-  target[X_AXIS] = lround(x*CONFIG_X_STEPS_PER_MM);
-  target[Y_AXIS] = lround(y*CONFIG_Y_STEPS_PER_MM);
-  target[Z_AXIS] = lround(z*CONFIG_Z_STEPS_PER_MM); 
+  queued_position[X_AXIS] = lround(x*CONFIG_X_STEPS_PER_MM);
+  queued_position[Y_AXIS] = lround(y*CONFIG_Y_STEPS_PER_MM);
+  queued_position[Z_AXIS] = lround(z*CONFIG_Z_STEPS_PER_MM); 
+  queued_position_update_requested = false;
+  queue_line(feed_rate, nominal_laser_intensity);
+}
+
+
+// Add a new linear movement given in steps relative to the end of the previous one.
+// Used by the binary protocol which already sends step deltas.
+void planner_line_relative_steps(int32_t dx, int32_t dy, int32_t dz, double feed_rate, uint8_t nominal_laser_intensity) {
+  update_queued_position();
+  queued_position[X_AXIS] += dx;
+  queued_position[Y_AXIS] += dy;
+  queued_position[Z_AXIS] += dz;
+  queue_line(feed_rate, nominal_laser_intensity);
+}
+
+
+static void queue_line(double feed_rate, uint8_t nominal_laser_intensity) {
+  motion_command_t command;
+  command.type = TYPE_LINE;
+  memcpy(command.target, queued_position, sizeof(queued_position));
+  command.feed_rate = feed_rate;
+  command.nominal_laser_intensity = nominal_laser_intensity;
+  command.line_number = queued_line_number;
+  planner_queue(&command);
+}
+
+
+// Plan a parsed command. Called by the planner task or directly by planner_queue().
+// Commands that were queued before a stop are discarded.
+void planner_execute(motion_command_t *command) {
+  if (stepper_stop_requested()) { return; }
+  switch (command->type) {
+    case TYPE_LINE:
+      planning_line_number = command->line_number;
+      plan_line_steps(command->target, command->feed_rate, command->nominal_laser_intensity);
+      break;
+    case COMMAND_SET_POSITION:
+      planner_lock();
+      memcpy(position, command->target, sizeof(position));
+      previous_nominal_speed = 0.0; // resets planner junction speeds
+      clear_vector_double(previous_unit_vec);
+      planner_unlock();
+      break;
+    case COMMAND_SET_BLENDING:
+      blend_tolerance = command->feed_rate;
+      break;
+    default:
+      planning_line_number = command->line_number;
+      plan_command(command->type);
+  }
+}
 
-  // calculate the buffer head and check for space
-  int next_buffer_head = next_block_index( block_buffer_head );	
+
+// Calculate the buffer head and check for space
+// Returns -1 when a stop came in meanwhile, the stepper emptied the buffer for
+// it and the command belongs to before the stop. The stop stays requested until
+// the command is done, stepper_synchronize() waits for the planner queue.
+static int8_t wait_for_free_block() {
+  int8_t next_buffer_head = next_block_index( block_buffer_head );	
+  if (block_buffer_tail == next_buffer_head) {
+    trace_event(TRACE_BUFFER_FULL, 0);
+  }
   while(block_buffer_tail == next_buffer_head) {  // buffer full condition
     // good! We are well ahead of the robot. Rest here until buffer has room.
+#ifndef PLANNER_TASK
+    gcode_execute_runtime();  // the parser waits here too
+#endif
     sleep_mode();
   }
+  if (stepper_stop_requested()) { return -1; }
+  return next_buffer_head;
+}
+
+
+// Plan a line to target in absolute steps
+static void plan_line_steps(int32_t *target, double feed_rate, uint8_t nominal_laser_intensity) {
+  stepper_snapshot_t snapshot;
+  int8_t next_buffer_head = wait_for_free_block();
+  if (next_buffer_head < 0) { return; }
+  planner_lock();
   
   // handle position update after a stop
   if (position_update_requested) {
-    planner_set_position(stepper_get_position_x(), stepper_get_position_y(), stepper_get_position_z());
+    stepper_get_snapshot(&snapshot);
+    memcpy(position, snapshot.steps, sizeof(position));
+    previous_nominal_speed = 0.0;
+    clear_vector_double(previous_unit_vec);
     position_update_requested = false;
     //printString("planner pos update\n");  // debug
   }
@@ -94,6 +200,7 @@ void planner_line(double x, double y, double z, double feed_rate, uint8_t nomina
 
   // set nominal laser intensity
   block->nominal_laser_intensity = nominal_laser_intensity;
+  block->line_number = planning_line_number;
 
   // compute direction bits for this block
   block->direction_bits = 0;
@@ -106,7 +213,11 @@ void planner_line(double x, double y, double z, double feed_rate, uint8_t nomina
   block->steps_y = labs(target[Y_AXIS]-position[Y_AXIS]);
   block->steps_z = labs(target[Z_AXIS]-position[Z_AXIS]);
   block->step_event_count = max(block->steps_x, max(block->steps_y, block->steps_z));
-  if (block->step_event_count == 0) { return; };  // bail if this is a zero-length block
+  if (block->step_event_count == 0) {  // bail if this is a zero-length block
+    planner_unlock();
+    return;
+  }
+  block->step_event_offset = 0;
   
   // compute path vector in terms of absolute step target and current positions
   double delta_mm[3];
@@ -120,7 +231,18 @@ void planner_line(double x, double y, double z, double feed_rate, uint8_t nomina
   
   // calculate nominal_speed (mm/min) and nominal_rate (step/min)
   // minimum stepper speed is limited by MINIMUM_STEPS_PER_MINUTE in stepper.c
-  double inverse_minute = feed_rate * inverse_millimeters;
+  double inverse_minute = feed_rate * feed_override/100.0 * inverse_millimeters;
+
+  // When the buffer runs low short blocks get slowed down so it does not run dry, the less
+  // is buffered the longer they have to last. An empty buffer plans to a stop, the
+  // machine stutters when the next block arrives too late.
+  double buffered = buffered_minutes();
+  if (buffered < CONFIG_SLOWDOWN_BUFFER_TIME/60.0) {
+    double min_minutes = CONFIG_SLOWDOWN_SEGMENT_TIME/60.0 * (1.0 - buffered*60.0/CONFIG_SLOWDOWN_BUFFER_TIME);
+    if (inverse_minute * min_minutes > 1.0) { 
+      inverse_minute = 1.0/min_minutes; 
+    }
+  }
   block->nominal_speed = block->millimeters * inverse_minute; // always > 0
   block->nominal_rate = ceil(block->step_event_count * inverse_minute); // always > 0
   
@@ -145,7 +267,9 @@ void planner_line(double x, double y, double z, double feed_rate, uint8_t nomina
   // path width or max_jerk in the previous grbl version. This approach does not actually deviate 
   // from path, but used as a robust way to compute cornering speeds, as it takes into account the
   // nonlinearities of both the junction angle and junction velocity.
-  double vmax_junction = ZERO_SPEED; // prime for junctions close to 0 degree
+  // The angle and deviation part of the limit is kept in junction_limit so the
+  // junction can be re-evaluated when a feed override changes the nominal speeds.
+  double junction_limit = ZERO_SPEED; // prime for junctions close to 0 degree
   if ((block_buffer_head != block_buffer_tail) && (previous_nominal_speed > 0.0)) {
     // Compute cosine of angle between previous and current path.
     // vmax_junction is computed without sin() or acos() by trig half angle identity.
@@ -154,41 +278,43 @@ void planner_line(double x, double y, double z, double feed_rate, uint8_t nomina
                        - previous_unit_vec[Z_AXIS] * unit_vec[Z_AXIS] ;
     if (cos_theta < 0.95) {
       // any junction *not* close to 0 degree
-      vmax_junction = min(previous_nominal_speed, block->nominal_speed);  // prime for close to 180
+      junction_limit = HUGE_VAL;  // prime for close to 180, only limited by the nominal speeds
       if (cos_theta > -0.95) {
         // any junction not close to neither 0 and 180 degree -> compute vmax
         double sin_theta_d2 = sqrt(0.5*(1.0-cos_theta)); // Trig half angle identity. Always positive.
-        vmax_junction = min( vmax_junction, sqrt( CONFIG_ACCELERATION * CONFIG_JUNCTION_DEVIATION 
-                                                  * sin_theta_d2/(1.0-sin_theta_d2) ) );
+        double radius = CONFIG_JUNCTION_DEVIATION * sin_theta_d2/(1.0-sin_theta_d2);
+        if (blend_tolerance > CONFIG_JUNCTION_DEVIATION) {
+          // G64: the corner may be rounded by an arc that stays within blend_tolerance of
+          // it. Its tangent points must be within the first half of either line, the
+          // other half belongs to the junction at the far end.
+          double tan_theta_d2 = sin_theta_d2/sqrt(0.5*(1.0+cos_theta));
+          double blend_radius = min( blend_tolerance * sin_theta_d2/(1.0-sin_theta_d2),
+                                     tan_theta_d2 * 0.5*min(previous_millimeters, block->millimeters) );
+          radius = max(radius, blend_radius);
+        }
+        junction_limit = sqrt( CONFIG_ACCELERATION * radius );
       }
     }
   }
-  block->vmax_junction = vmax_junction;
+  block->junction_limit = junction_limit;
+  block->vmax_junction = min(junction_limit, min(previous_nominal_speed, block->nominal_speed));
   
-  // Initialize entry_speed. Compute based on deceleration to zero.
-  // This will be updated in the forward and reverse planner passes.
-  double v_allowable = max_allowable_speed(-CONFIG_ACCELERATION, ZERO_SPEED, block->millimeters);
-  block->entry_speed = min(vmax_junction, v_allowable);
-
-  // Set nominal_length_flag for more efficiency.
-  // If a block can de/ac-celerate from nominal speed to zero within the length of 
-  // the block, then the speed will always be at the the maximum junction speed and 
-  // may always be ignored for any speed reduction checks.
-  if (block->nominal_speed <= v_allowable) { block->nominal_length_flag = true; }
-  else { block->nominal_length_flag = false; }
-  block->recalculate_flag = true; // always calculate trapezoid for new block
+  initialize_entry_speed(block);
 
   // update previous unit_vector and nominal speed
   memcpy(previous_unit_vec, unit_vec, sizeof(unit_vec)); // previous_unit_vec[] = unit_vec[]
   previous_nominal_speed = block->nominal_speed;
+  previous_millimeters = block->millimeters;
   //// end of acceleeration manager calculations
 
 
   // move buffer head and update position
   block_buffer_head = next_buffer_head;     
-  memcpy(position, target, sizeof(target)); // position[] = target[]
+  trace_event(TRACE_BLOCK_PUSHED, planner_blocks_queued());
+  memcpy(position, target, sizeof(position)); // position[] = target[]
 
   planner_recalculate();
+  planner_unlock();
 
   // make sure the stepper interrupt is processing
   stepper_wake_up();
@@ -210,21 +336,29 @@ void planner_dwell(double seconds, uint8_t nominal_laser_intensity) {
 
 
 void planner_command(uint8_t type) {
-  // calculate the buffer head and check for space
-  int next_buffer_head = next_block_index( block_buffer_head );	
-  while(block_buffer_tail == next_buffer_head) {  // buffer full condition
-    // good! We are well ahead of the robot. Rest here until buffer has room.
-    sleep_mode();
-  }    
+  motion_command_t command;
+  command.type = type;
+  command.line_number = queued_line_number;
+  planner_queue(&command);
+}
+
+
+static void plan_command(uint8_t type) {
+  int8_t next_buffer_head = wait_for_free_block();
+  if (next_buffer_head < 0) { return; }
+  planner_lock();
 
   // Prepare to set up new block
   block_t *block = &block_buffer[block_buffer_head];
 
   // set block type command
   block->type = type;
+  block->line_number = planning_line_number;
 
   // Move buffer head
   block_buffer_head = next_buffer_head;
+  trace_event(TRACE_BLOCK_PUSHED, planner_blocks_queued());
+  planner_unlock();
 
   // make sure the stepper interrupt is processing  
   stepper_wake_up();
@@ -236,6 +370,14 @@ bool planner_blocks_available() {
   return block_buffer_head != block_buffer_tail;
 }
 
+uint8_t planner_blocks_queued() {
+  return (block_buffer_head - block_buffer_tail + BLOCK_BUFFER_SIZE) % BLOCK_BUFFER_SIZE;
+}
+
+void planner_set_line_number(uint32_t line_number) {
+  queued_line_number = line_number;
+}
+
 block_t *planner_get_current_block() {
   if (block_buffer_head == block_buffer_tail) { return(NULL); }
   return(&block_buffer[block_buffer_tail]);
@@ -252,24 +394,142 @@ void planner_reset_block_buffer() {
   block_buffer_tail = 0;
 }
 
+// Only the untraced part of the current block is planned again, from zero speed.
+// Its bresenham parameters are left alone so the stepper continues on the exact
+// same path. The trapezoid indices get offset by the already traced step events.
+void planner_replan_from_stop(uint32_t step_events_completed) {
+  block_t *block = planner_get_current_block();
+  if (block == NULL) { return; }
+  planner_lock();
+  if (block->type == TYPE_LINE) {
+    block->millimeters = (block->millimeters * (block->step_event_count - step_events_completed))
+                         / (block->step_event_count - block->step_event_offset);
+    block->step_event_offset = step_events_completed;
+    block->entry_speed = ZERO_SPEED;
+    block->vmax_junction = ZERO_SPEED;
+    block->nominal_length_flag = false;
+    block->recalculate_flag = true;
+  }
+  planner_recalculate();
+  planner_unlock();
+}
+
 
 
 
 // Reset the planner position vector and planner speed
+// Takes effect in order with the queued lines.
 void planner_set_position(double x, double y, double z) {
-  position[X_AXIS] = lround(x*CONFIG_X_STEPS_PER_MM);
-  position[Y_AXIS] = lround(y*CONFIG_Y_STEPS_PER_MM);
-  position[Z_AXIS] = lround(z*CONFIG_Z_STEPS_PER_MM);    
-  previous_nominal_speed = 0.0; // resets planner junction speeds
-  clear_vector_double(previous_unit_vec);
+  motion_command_t command;
+  queued_position[X_AXIS] = lround(x*CONFIG_X_STEPS_PER_MM);
+  queued_position[Y_AXIS] = lround(y*CONFIG_Y_STEPS_PER_MM);
+  queued_position[Z_AXIS] = lround(z*CONFIG_Z_STEPS_PER_MM);    
+  queued_position_update_requested = false;
+  command.type = COMMAND_SET_POSITION;
+  memcpy(command.target, queued_position, sizeof(queued_position));
+  planner_queue(&command);
 }
 
+void planner_get_position(double *target) {
+  update_queued_position();
+  target[X_AXIS] = queued_position[X_AXIS]/CONFIG_X_STEPS_PER_MM;
+  target[Y_AXIS] = queued_position[Y_AXIS]/CONFIG_Y_STEPS_PER_MM;
+  target[Z_AXIS] = queued_position[Z_AXIS]/CONFIG_Z_STEPS_PER_MM;
+}
+
+// After a stop the queued commands are gone, continue from the stepper position
+static void update_queued_position() {
+  if (queued_position_update_requested) {
+    stepper_snapshot_t snapshot;
+    stepper_get_snapshot(&snapshot);
+    memcpy(queued_position, snapshot.steps, sizeof(queued_position));
+    queued_position_update_requested = false;
+  }
+}
+
+
 void planner_request_position_update() {
   position_update_requested = true;
+  queued_position_update_requested = true;
+}
+
+
+// Scale the nominal speed of all buffered blocks to a new feed override and replan.
+// The block the stepper interrupt is tracing keeps its speeds to the end, it may
+// already be too close to its end to reach a lower exit speed. The block after
+// it is still entered at the speed planned before and, when that is above its
+// new nominal speed, slows down to it at the regular acceleration.
+void planner_set_feed_override(uint8_t percent) {
+  planner_lock();
+  double factor = (double)percent/feed_override;
+  feed_override = percent;
+  previous_nominal_speed *= factor;
+  
+  bool traced = (stepper_get_state() == STEPPER_RUNNING);  // tail block entered, no hold
+  bool after_traced = false;    // block entered where the traced one ends
+  double previous_speed = 0.0;  // nominal speed of the previous line block
+  int8_t block_index = block_buffer_tail;
+  while(block_index != block_buffer_head) {
+    block_t *block = &block_buffer[block_index];
+    if (block->type == TYPE_LINE) {
+      if (block_index == block_buffer_tail && traced) {
+        previous_speed = block->nominal_speed;
+        after_traced = true;
+        block_index = next_block_index( block_index );
+        continue;
+      }
+      block->nominal_speed *= factor;
+      block->nominal_rate = ceil( (block->step_event_count - block->step_event_offset) 
+                                  * block->nominal_speed / block->millimeters );
+      if (block_index == block_buffer_tail) {
+        // held, replanned from standstill on resume
+        block->entry_speed = min(block->entry_speed, block->nominal_speed);
+      } else if (!after_traced) {
+        block->vmax_junction = min(block->junction_limit, min(previous_speed, block->nominal_speed));
+        initialize_entry_speed(block);
+      }
+      block->recalculate_flag = true;
+      previous_speed = block->nominal_speed;
+      after_traced = false;
+    }
+    block_index = next_block_index( block_index );
+  }
+  if (block_buffer_head != block_buffer_tail) {
+    planner_recalculate();
+  }
+  planner_unlock();
+}
+
+uint8_t planner_get_feed_override() {
+  return feed_override;
+}
+
+
+// Set the G64 path tolerance in mm, 0 for G61. Takes effect in order with the queued lines.
+void planner_set_blend_tolerance(double tolerance) {
+  motion_command_t command;
+  command.type = COMMAND_SET_BLENDING;
+  command.feed_rate = tolerance;
+  planner_queue(&command);
 }
 
 
 
+// Execution time of the buffered line blocks at their nominal speeds
+static double buffered_minutes() {
+  double minutes = 0.0;
+  int8_t block_index = block_buffer_tail;
+  while(block_index != block_buffer_head) {
+    block_t *block = &block_buffer[block_index];
+    if (block->type == TYPE_LINE) {
+      minutes += block->millimeters / block->nominal_speed;
+    }
+    block_index = next_block_index( block_index );
+  }
+  return minutes;
+}
+
+
 // Returns the index of the next block in the ring buffer.
 static int8_t next_block_index(int8_t block_index) {
   block_index++;
@@ -350,29 +610,49 @@ static double max_allowable_speed(double acceleration, double target_velocity, d
 **                      accelerate_until    decelerate_after                           
 */                                                                              
 // Calculates accelerate_until and decelerate_after.
+// Only the step events after step_event_offset are planned (see planner_replan_from_stop).
 static void calculate_trapezoid_for_block(block_t *block, double entry_factor, double exit_factor) {
+  int32_t step_events = block->step_event_count - block->step_event_offset;
   block->initial_rate = ceil(block->nominal_rate * entry_factor);  // (step/min)
   block->final_rate = ceil(block->nominal_rate * exit_factor);     // (step/min)
   int32_t acceleration_per_minute = block->rate_delta * ACCELERATION_TICKS_PER_SECOND * 60; // (step/min^2)
-  int32_t accelerate_steps = 
-    ceil(estimate_acceleration_distance(block->initial_rate, block->nominal_rate, acceleration_per_minute));
+  // entered above the nominal rate after a lower feed override: no acceleration,
+  // the stepper interrupt slows down to nominal_rate while cruising
+  int32_t accelerate_steps = max(0,
+    ceil(estimate_acceleration_distance(block->initial_rate, block->nominal_rate, acceleration_per_minute)));
   int32_t decelerate_steps = 
     floor(estimate_acceleration_distance(block->nominal_rate, block->final_rate, -acceleration_per_minute));
     
   // Calculate the size of Plateau of Nominal Rate. 
-  int32_t plateau_steps = block->step_event_count-accelerate_steps-decelerate_steps;
+  int32_t plateau_steps = step_events-accelerate_steps-decelerate_steps;
   
   // Handle special case where we don't reach a plateau.
   if (plateau_steps < 0) {  
     accelerate_steps = ceil( intersection_distance( block->initial_rate, block->final_rate, 
-                             acceleration_per_minute, block->step_event_count ) );
+                             acceleration_per_minute, step_events ) );
     accelerate_steps = max(accelerate_steps, 0);  // check limits due to numerical round-off
-    accelerate_steps = min(accelerate_steps, block->step_event_count);
+    accelerate_steps = min(accelerate_steps, step_events);
     plateau_steps = 0;
   }  
   
-  block->accelerate_until = accelerate_steps;
-  block->decelerate_after = accelerate_steps+plateau_steps;
+  block->accelerate_until = block->step_event_offset+accelerate_steps;
+  block->decelerate_after = block->step_event_offset+accelerate_steps+plateau_steps;
+}
+
+
+// Initialize entry_speed. Compute based on deceleration to zero.
+// This will be updated in the forward and reverse planner passes.
+static void initialize_entry_speed(block_t *block) {
+  double v_allowable = max_allowable_speed(-CONFIG_ACCELERATION, ZERO_SPEED, block->millimeters);
+  block->entry_speed = min(block->vmax_junction, v_allowable);
+
+  // Set nominal_length_flag for more efficiency.
+  // If a block can de/ac-celerate from nominal speed to zero within the length of 
+  // the block, then the speed will always be at the the maximum junction speed and 
+  // may always be ignored for any speed reduction checks.
+  if (block->nominal_speed <= v_allowable) { block->nominal_length_flag = true; }
+  else { block->nominal_length_flag = false; }
+  block->recalculate_flag = true; // always calculate trapezoid for new block
 }
 
 
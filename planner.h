@@ -30,6 +30,9 @@
 #define TYPE_AIR_ENABLE 2
 #define TYPE_GAS_ENABLE 3
 
+#define COMMAND_SET_POSITION 0x80  // only in the command queue, never becomes a block
+#define COMMAND_SET_BLENDING 0x81  // only in the command queue, never becomes a block
+
 #define planner_control_airgas_disable() planner_command(TYPE_AIRGAS_DISABLE)
 #define planner_control_air_enable() planner_command(TYPE_AIR_ENABLE)
 #define planner_control_gas_enable() planner_command(TYPE_GAS_ENABLE)
@@ -43,13 +46,16 @@ typedef struct {
   uint32_t steps_x, steps_y, steps_z; // Step count along each axis
   uint8_t  direction_bits;            // The direction bit set for this block (refers to *_DIRECTION_BIT in config.h)
   int32_t  step_event_count;          // The number of step events required to complete this block
+  uint32_t step_event_offset;         // Step events already traced when replanned after a feed hold
   uint32_t nominal_rate;              // The nominal step rate for this block in step_events/minute
   // Fields used by the motion planner to manage acceleration
   double nominal_speed;               // The nominal speed for this block in mm/min  
   double entry_speed;                 // Entry speed at previous-current junction in mm/min
   double vmax_junction;               // max junction speed (mm/min) based on angle between segments, accel and deviation settings
+  double junction_limit;              // the part of vmax_junction independent of the nominal speeds (mm/min)
   double millimeters;                 // The total travel of this block in mm
   uint8_t nominal_laser_intensity;    // 0-255 is 0-100% percentage
+  uint32_t line_number;               // of the g-code line the block came from
   bool recalculate_flag;              // Planner flag to recalculate trapezoids on entry junction
   bool nominal_length_flag;           // Planner flag for nominal speed always reached
   // Settings for the trapezoid generator
@@ -61,6 +67,15 @@ typedef struct {
 
 } block_t;
       
+// A parsed command on its way to the planner, see planner_execute()
+typedef struct {
+  uint8_t type;                       // TYPE_LINE, TYPE_AIR_ENABLE, ... or COMMAND_SET_POSITION
+  int32_t target[3];                  // Absolute target in steps
+  double feed_rate;                   // mm/min, the tolerance in mm for COMMAND_SET_BLENDING
+  uint8_t nominal_laser_intensity;    // 0-255 is 0-100% percentage
+  uint32_t line_number;               // of the g-code line, for the blocks
+} motion_command_t;
+      
 // Initialize the motion plan subsystem      
 void planner_init();
 
@@ -68,9 +83,27 @@ void planner_init();
 // the signed, absolute target position in millimaters. Feed rate specifies the speed of the motion.
 void planner_line(double x, double y, double z, double feed_rate, uint8_t nominal_laser_intensity);
 
+// Add a new linear movement given in steps relative to the end of the previous movement
+void planner_line_relative_steps(int32_t dx, int32_t dy, int32_t dz, double feed_rate, uint8_t nominal_laser_intensity);
+
 // Add a new piercing action, lasing at one spot
 void planner_dwell(double seconds, uint8_t nominal_laser_intensity);
 
+// Plan a parsed command, called in order for everything the functions above queue
+void planner_execute(motion_command_t *command);
+
+#ifdef PLANNER_TASK
+// Provided by the arch when the planner runs in its own task. planner_queue() hands
+// a command to that task, the lock keeps the parser side replanning functions
+// (feed override, resume) off the block buffer while a block is being added.
+void planner_queue(motion_command_t *command);
+void planner_lock();
+void planner_unlock();
+bool planner_queue_idle();  // true when all queued commands are in the block buffer
+#else
+#define planner_queue_idle() true  // every command is planned as it is queued
+#endif
+
 // Add a non-motion command to the queue.
 // Typical types are: TYPE_AIRGAS_DISABLE, TYPE_AIR_ENABLE, TYPE_GAS_ENABLE
 void planner_command(uint8_t type);
@@ -78,6 +111,12 @@ void planner_command(uint8_t type);
 
 bool planner_blocks_available();
 
+// number of blocks in the buffer, including the one being traced
+uint8_t planner_blocks_queued();
+
+// the g-code line the blocks queued from now on belong to
+void planner_set_line_number(uint32_t line_number);
+
 // Gets the current block. Returns NULL if buffer empty
 block_t *planner_get_current_block();
 
@@ -88,12 +127,27 @@ void planner_discard_current_block();
 // purge all command in the buffer
 void planner_reset_block_buffer();
 
+// Replan all buffered blocks to start from standstill after a feed hold.
+// The current block may already be partially traced up to step_events_completed.
+void planner_replan_from_stop(uint32_t step_events_completed);
+
 
 // Reset the position vector
 void planner_set_position(double x, double y, double z);
 
+// Get the planned end position in millimeters, as an array indexed by X_AXIS, Y_AXIS, Z_AXIS
+void planner_get_position(double *target);
+
 // update to stepper position when steppers have been stopped
 // called from the stepper code that executes the stop
 void planner_request_position_update();
 
+// Set the feed override in percent, rescales and replans all buffered blocks
+void planner_set_feed_override(uint8_t percent);
+uint8_t planner_get_feed_override();
+
+// Set the path tolerance in mm within which corners may be rounded (G64 P),
+// 0 traces the exact path (G61). Takes effect in order with the queued lines.
+void planner_set_blend_tolerance(double tolerance);
+
 #endif
@@ -26,6 +26,8 @@
 #include "iodefine.h"
 #define LASER_PIN	PORTA.DR.BIT.B0
 
+static volatile uint8_t laser_intensity;
+
 void sense_init() {
 	LASER_PIN = 0;
 
@@ -71,6 +73,7 @@ void control_init() {
 
 
 void control_laser_intensity(uint8_t intensity) {
+	laser_intensity = intensity;
 /*
   OCR0A = intensity;
 */
@@ -83,6 +86,10 @@ void control_laser_intensity(uint8_t intensity) {
 }
 
 
+uint8_t control_get_laser_intensity() {
+	return laser_intensity;
+}
+
 
 void control_air(bool enable) {
 /*
@@ -37,6 +37,7 @@ void sense_init();
 void control_init();
 
 void control_laser_intensity(uint8_t intensity);  //0-255 is 0-100%
+uint8_t control_get_laser_intensity();            // as last set
 
 void control_air(bool enable);
 void control_gas(bool enable);
@@ -24,14 +24,25 @@
 #define serial_h
 
 #include "stdint.h"
+#include <stdbool.h>
 
 #define SERIAL_NO_DATA 0xff
 
 
 void serial_init();
 void serial_write(uint8_t data);
+// The status push shares the port with the responses: serial_write() holds it
+// from the first byte of a line to the '\n', serial_write_line() writes a whole
+// line only when the port is free and returns false when it was not.
+bool serial_write_line(const char *line);
 uint8_t serial_read();
-uint8_t serial_available();
+// Blocks until a byte or a real-time command came in, or timeout_ms passed,
+// so the grbl loop waits instead of polling serial_read(). Returns at once
+// when there is something to read.
+void serial_wait(uint16_t timeout_ms);
+uint16_t serial_available();           // bytes received but not yet read
+uint16_t serial_get_overrun_count();   // bytes dropped on a full receive buffer
+void serial_reset_read_buffer();
 
 
 void printString(const char *s);
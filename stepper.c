@@ -40,9 +40,6 @@
   Speed adjustments are made ACCELERATION_TICKS_PER_SECOND times per second.  
 */
 #include "dev_misc.h"
-#include "board.h"
-
-#include "iodefine.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -52,45 +49,16 @@
 #include "gcode.h"
 #include "planner.h"
 #include "sense_control.h"
-#include "serial.h"  //for debug
-
-#include "FreeRTOS.h"
-#include "task.h"
-
-#define STEPPER_X_A1	LED5
-#define STEPPER_X_A2	LED6	
-#define STEPPER_X_B1	LED7	
-#define STEPPER_X_B2	LED8	
-
-#define STEPPER_Y_A1 	LED1	
-#define STEPPER_Y_A2 	LED2	
-#define STEPPER_Y_B1 	LED3
-#define STEPPER_Y_B2 	LED4
-
-#define STEPPER_Z_A1 	LED9
-#define STEPPER_Z_A2 	LED10
-#define STEPPER_Z_B1 	LED11
-#define STEPPER_Z_B2 	LED12
-
-//#define STEPPER_X_ENABLE LED12
-//#define STEPPER_Y_ENABLE LED13
-
-#define STEPPER_ALL_PINS STEPPER_X_A1 = STEPPER_X_A2 = STEPPER_X_B1=STEPPER_X_B2=STEPPER_Y_A1=STEPPER_Y_A2=STEPPER_Y_B1=STEPPER_Y_B2=STEPPER_Z_A1=STEPPER_Z_A2=STEPPER_Z_B1=STEPPER_Z_B2//=STEPPER_X_ENABLE=STEPPER_Y_ENABLE
-
-#define STEPPER_PORT 	0
-
-#define DIR_FORWARD	1
-#define DIR_BACKWARD	0
+#include "trace.h"
 
 #define CYCLES_PER_MICROSECOND (F_CPU/1000000)  //16000000/1000000 = 16
 #define CYCLES_PER_ACCELERATION_TICK (F_CPU/ACCELERATION_TICKS_PER_SECOND)  // 24MHz/100 = 240000
 
-void do_full_step(int direction, int axis);
-void do_half_step(int direction, int axis);
-
 volatile int do_int = 0;
 
-static int32_t stepper_position[3];  // real-time position in absolute steps
+static volatile int32_t stepper_position[3];  // real-time position in absolute steps
+static volatile uint32_t position_time;        // dev_timestamp() of the last step
+static volatile uint32_t position_sequence;    // odd while the above are being written
 static block_t *current_block;  // A pointer to the block currently being traced
 
 // Variables used by The Stepper Driver Interrupt
@@ -109,44 +77,40 @@ static uint32_t adjusted_rate;                // The current rate of step_events
 static bool processing_flag;                  // indicates if blocks are being processed
 static volatile bool stop_requested;          // when set to true stepper interrupt will go idle on next entry
 static volatile uint8_t stop_status;          // yields the reason for a stop request
+static volatile uint8_t hold_state;           // feed hold progress, one of HOLD_*
+static uint32_t previous_final_rate;          // exit rate of the last line block, to carry a hold deceleration over
+static volatile bool drained;                 // went idle because the block buffer ran empty
+static volatile uint32_t drained_at;          // dev_timestamp() when that happened
+static volatile uint16_t starvation_count;    // drains followed by a block within STARVATION_TIME_MS
+static volatile uint32_t line_number;         // g-code line of the last block popped
+static isr_timing_t isr_execution;            // time spent in stepper_handler()
+static isr_timing_t isr_latency;              // from the step timer firing to stepper_handler()
+
+#define HOLD_NONE 0
+#define HOLD_DECELERATING 1  // slowing down at rate_delta, possibly across blocks
+#define HOLD_COMPLETE 2      // standing still, current_block and bresenham state preserved
 
 
 // prototypes for static functions (non-accesible from other files)
 static bool acceleration_tick();
 static void adjust_speed( uint32_t steps_per_minute );
+static void record_timing(isr_timing_t *timing, uint32_t ns);
 
 // Initialize and start the stepper motor subsystem
 void stepper_init() {  
-  // Configure directions of interface pins
-  	//GPIO_SetDirection(STEPPER_PORT, 0, STEPPER_ALL_PINS);
-	STEPPER_ALL_PINS=0;//GPIO_Write(STEPPER_PORT,0, STEPPER_ALL_PINS); //clear all
-
-	MSTP( CMT2 ) = 0;
-
-	/* Interrupt on compare match. */
-	CMT2.CMCR.BIT.CMIE = 1;
-
-	/* Set the compare match value. */
-	CMT2.CMCOR = ( unsigned short ) (PCLK_FREQUENCY/512)*2;
-
-	/* Divide the PCLK by 512. */
-	CMT2.CMCR.BIT.CKS = 3;
-
-	/* Enable the interrupt... */
-	_IEN( _CMT2_CMI2 ) = 1;
-
-	_IPR( _CMT2_CMI2 ) = 1;
-
-	/* Start the timers. */
-	CMT.CMSTR1.BIT.STR2 = 1;
-
-  
+  dev_stepper_init();
   adjust_speed(MINIMUM_STEPS_PER_MINUTE);
-  clear_vector(stepper_position);
+  stepper_position[X_AXIS] = stepper_position[Y_AXIS] = stepper_position[Z_AXIS] = 0;
+  position_time = dev_timestamp();
   acceleration_tick_counter = 0;
   current_block = NULL;
   stop_requested = false;
   stop_status = STATUS_OK;
+  hold_state = HOLD_NONE;
+  previous_final_rate = 0;
+  drained = false;
+  starvation_count = 0;
+  stepper_clear_isr_timing();
   busy = false;
   
   // start in the idle state
@@ -156,21 +120,29 @@ void stepper_init() {
 
 
 // block until all command blocks are executed
+// including the ones still queued for the planner task
 void stepper_synchronize() {
-  while(processing_flag) { 
+  while(!planner_queue_idle() || processing_flag) { 
     sleep_mode();
   }
 }
 
 
 // start processing command blocks
+// while a feed hold is in effect the blocks only get queued
 void stepper_wake_up() {
   if (!processing_flag) {
+    if (drained && (dev_timestamp() - drained_at) < STARVATION_TIME_MS*(DEV_TIMESTAMP_HZ/1000)) {
+      starvation_count++;
+    }
+    drained = false;
     processing_flag = true;
     // Initialize stepper output bits
     out_bits = INVERT_MASK;
     // Enable stepper driver interrupt
-    do_int = 1; //TIMSK1 |= (1<<OCIE1A);
+    if (hold_state == HOLD_NONE) {
+      do_int = 1; //TIMSK1 |= (1<<OCIE1A);
+    }
   }
 }
 
@@ -187,6 +159,21 @@ void stepper_go_idle() {
 void stepper_request_stop(uint8_t status) {
   stop_status = status;
   stop_requested = true;
+  if (processing_flag) {
+    // a completed feed hold has the interrupt disabled, let it absorb the blocks
+    do_int = 1;
+  }
+}
+
+// decelerate to a standstill, keeping all blocks for stepper_resume()
+void stepper_request_hold() {
+  if (hold_state == HOLD_NONE) {
+    if (processing_flag) {
+      hold_state = HOLD_DECELERATING;
+    } else {
+      hold_state = HOLD_COMPLETE;
+    }
+  }
 }
 
 bool stepper_stop_requested() {
@@ -197,25 +184,112 @@ uint8_t stepper_stop_status() {
   return stop_status;
 }
 
+// clear a stop request and continue after a feed hold
+// replans the buffer, must be called from the grbl task
 void stepper_resume() {
   stop_requested = false;
+  if (hold_state != HOLD_NONE) {
+    while (hold_state == HOLD_DECELERATING) {
+      sleep_mode();
+    }
+    if (current_block != NULL && current_block->type == TYPE_LINE) {
+      planner_replan_from_stop(step_events_completed);
+      adjusted_rate = current_block->initial_rate;
+      adjust_speed( adjusted_rate );
+    } else {
+      planner_replan_from_stop(0);
+    }
+    acceleration_tick_counter = CYCLES_PER_ACCELERATION_TICK/2;
+    hold_state = HOLD_NONE;
+    if (processing_flag) {
+      do_int = 1;
+    }
+  }
 }
 
 
-double stepper_get_position_x() {
-  return stepper_position[X_AXIS]/CONFIG_X_STEPS_PER_MM;
+uint16_t stepper_get_starvation_count() {
+  return starvation_count;
+}
+
+void stepper_clear_starvation_count() {
+  starvation_count = 0;
 }
-double stepper_get_position_y() {
-  return stepper_position[Y_AXIS]/CONFIG_Y_STEPS_PER_MM;
+
+
+uint8_t stepper_get_state() {
+  if (stop_requested) { return STEPPER_STOPPED; }
+  if (hold_state != HOLD_NONE) { return STEPPER_HOLDING; }
+  if (processing_flag) { return STEPPER_RUNNING; }
+  return STEPPER_IDLE;
 }
-double stepper_get_position_z() {
-  return stepper_position[Z_AXIS]/CONFIG_Z_STEPS_PER_MM;
+
+double stepper_get_feed_rate() {
+  block_t *block = current_block;  // the interrupt may drop it meanwhile, the memory stays
+  if (block == NULL || block->type != TYPE_LINE || block->step_event_count == block->step_event_offset ||
+      hold_state == HOLD_COMPLETE) {
+    return 0.0;
+  }
+  // after a hold millimeters only covers the step events left at the resume
+  return (double)adjusted_rate * block->millimeters / (block->step_event_count - block->step_event_offset);
 }
+
+uint32_t stepper_get_line_number() {
+  return line_number;
+}
+
+
+void stepper_get_isr_timing(isr_timing_t *execution, isr_timing_t *latency) {
+  uint32_t flags = dev_irq_save();
+  *execution = isr_execution;
+  *latency = isr_latency;
+  dev_irq_restore(flags);
+}
+
+void stepper_clear_isr_timing() {
+  uint32_t flags = dev_irq_save();
+  memset(&isr_execution, 0, sizeof(isr_timing_t));
+  memset(&isr_latency, 0, sizeof(isr_timing_t));
+  isr_execution.min = isr_latency.min = UINT32_MAX;
+  dev_irq_restore(flags);
+}
+
+void stepper_record_isr_timing(uint32_t execution_ns, uint32_t latency_ns) {
+  record_timing(&isr_execution, execution_ns);
+  record_timing(&isr_latency, latency_ns);
+}
+
+
+// Seqlock read: the interrupt makes position_sequence odd while it steps and even
+// again after, a copy taken while it was odd or that saw it change is retried.
+// Interrupts stay enabled, a status poll costs the step timing nothing.
+void stepper_get_snapshot(stepper_snapshot_t *snapshot) {
+  uint32_t sequence;
+  do {
+    sequence = position_sequence;
+    snapshot->steps[X_AXIS] = stepper_position[X_AXIS];
+    snapshot->steps[Y_AXIS] = stepper_position[Y_AXIS];
+    snapshot->steps[Z_AXIS] = stepper_position[Z_AXIS];
+    snapshot->time = position_time;
+  } while ((sequence & 1) || sequence != position_sequence);
+}
+
+void stepper_get_position(double *position) {
+  stepper_snapshot_t snapshot;
+  stepper_get_snapshot(&snapshot);
+  position[X_AXIS] = snapshot.steps[X_AXIS]/CONFIG_X_STEPS_PER_MM;
+  position[Y_AXIS] = snapshot.steps[Y_AXIS]/CONFIG_Y_STEPS_PER_MM;
+  position[Z_AXIS] = snapshot.steps[Z_AXIS]/CONFIG_Z_STEPS_PER_MM;
+}
+
 void stepper_set_position(double x, double y, double z) {
   stepper_synchronize();  // wait until processing is done
+  position_sequence++;
   stepper_position[X_AXIS] = floor(x*CONFIG_X_STEPS_PER_MM + 0.5);
   stepper_position[Y_AXIS] = floor(y*CONFIG_Y_STEPS_PER_MM + 0.5);
   stepper_position[Z_AXIS] = floor(z*CONFIG_Z_STEPS_PER_MM + 0.5);  
+  position_time = dev_timestamp();
+  position_sequence++;
 }
 
 /*
@@ -231,47 +305,19 @@ ISR(TIMER2_OVF_vect) {
   */
 
 // The Stepper ISR
-// This is the workhorse of LasaurGrbl. It is executed at the rate set with
-// config_step_timer. It pops blocks from the block_buffer and executes them by pulsing the stepper pins appropriately.
+// This is the workhorse of LasaurGrbl. The arch's step timer interrupt (stepper_handler()
+// in dev_stepper.c) calls it at the rate set with dev_stepper_period() while do_int is set.
+// It pops blocks from the block_buffer and executes them by pulsing the stepper pins appropriately.
 // The bresenham line tracer algorithm controls all three stepper outputs simultaneously.
-  void stepper_handler( void ) __attribute__((interrupt));
-void stepper_handler()
-{        
-	if(!do_int)
-		return;
-
-	led_toggle();
-
-	if(out_bits & (1<<X_STEP_BIT)) {
-		if(out_bits & (1<<X_DIRECTION_BIT)) {
-//			do_half_step(DIR_BACKWARD, X_AXIS);
-			do_full_step(DIR_BACKWARD, X_AXIS);
-		} else {
-			//do_half_step(DIR_FORWARD, X_AXIS);
-			do_full_step(DIR_FORWARD, X_AXIS);
-		}
-	}	
-	if(out_bits & (1<<Y_STEP_BIT)) {
-		if(out_bits & (1<<Y_DIRECTION_BIT)) {
-//			do_half_step(DIR_FORWARD, Y_AXIS);
-			do_full_step(DIR_FORWARD, Y_AXIS);
-		} else {
-	//		do_half_step(DIR_BACKWARD, Y_AXIS);
-			do_full_step(DIR_BACKWARD, Y_AXIS);
-		}	
-	}
-	if(out_bits & (1<<Z_STEP_BIT)) {
-		if(out_bits & (1<<Z_DIRECTION_BIT)) {
-//			do_half_step(DIR_FORWARD, Z_AXIS);
-			do_full_step(DIR_FORWARD, Z_AXIS);
-		} else {
-//			do_half_step(DIR_BACKWARD, Z_AXIS);
-			do_full_step(DIR_BACKWARD, Z_AXIS);
-		}	
-	}
+void stepper_interrupt()
+{
+  // the steps worked out on the last interrupt, one period ago
+  dev_stepper_pulse(out_bits);
+
   busy = true;
   if (stop_requested) {
     // go idle and absorb any blocks
+    hold_state = HOLD_NONE;
     stepper_go_idle(); 
     planner_reset_block_buffer();
     planner_request_position_update();
@@ -316,13 +362,29 @@ void stepper_handler()
     current_block = planner_get_current_block();
     // if still no block command, go idle, disable interrupt
     if (current_block == NULL) {
+      if (hold_state == HOLD_DECELERATING) { 
+        hold_state = HOLD_COMPLETE; 
+      } else {
+        drained = true;
+        trace_event(TRACE_BUFFER_EMPTY, 0);
+        drained_at = dev_timestamp();
+      }
       stepper_go_idle();
       busy = false;
       return;       
     }      
+    trace_event(TRACE_BLOCK_STARTED, min(current_block->step_event_count, 0xFFFF));
+    line_number = current_block->line_number;
     if (current_block->type == TYPE_LINE) {  // starting on new line block
-      adjusted_rate = current_block->initial_rate;
-      acceleration_tick_counter = CYCLES_PER_ACCELERATION_TICK/2; // start halfway, midpoint rule.
+      if (hold_state == HOLD_NONE) {
+        adjusted_rate = current_block->initial_rate;
+        acceleration_tick_counter = CYCLES_PER_ACCELERATION_TICK/2; // start halfway, midpoint rule.
+      } else if (previous_final_rate > 0) {
+        // decelerating for a hold, continue from the actual speed scaled to this block
+        adjusted_rate = ((uint64_t)adjusted_rate * current_block->initial_rate) / previous_final_rate;
+      } else {
+        adjusted_rate = current_block->initial_rate;
+      }
       adjust_speed( adjusted_rate ); // initialize cycles_per_step_event
       counter_x = -(current_block->step_event_count >> 1);
       counter_y = counter_x;
@@ -335,6 +397,7 @@ void stepper_handler()
   switch (current_block->type) {
     case TYPE_LINE:
       ////// Execute step displacement profile by bresenham line algorithm
+      position_sequence++;  // publish the position, see stepper_get_snapshot()
       out_bits = current_block->direction_bits;
       counter_x += current_block->steps_x;
       if (counter_x > 0) {
@@ -369,6 +432,8 @@ void stepper_handler()
           stepper_position[Z_AXIS] += 1;
         }        
       }
+      position_time = dev_timestamp();
+      position_sequence++;
       //////
       
       step_events_completed++;  // increment step count
@@ -379,8 +444,24 @@ void stepper_handler()
       ////////// SPEED ADJUSTMENT
       if (step_events_completed < current_block->step_event_count) {  // block not finished
       
+        // feed hold, decelerate from wherever we are
+        if (hold_state == HOLD_DECELERATING) {
+          if ( acceleration_tick() ) {  // scheduled speed change
+            if (adjusted_rate <= current_block->rate_delta) {
+              // Standing still. Keep current_block and the bresenham counters, the
+              // pending out_bits get pulsed on the first interrupt after resuming.
+              hold_state = HOLD_COMPLETE;
+              do_int = 0;
+              control_laser_intensity(0);
+            } else {
+              adjusted_rate -= current_block->rate_delta;
+              adjust_speed( adjusted_rate );
+            }
+          }
+
         // accelerating
-        if (step_events_completed < current_block->accelerate_until) {
+        } else if (step_events_completed < current_block->accelerate_until
+                   && adjusted_rate < current_block->nominal_rate) {
           if ( acceleration_tick() ) {  // scheduled speed change
             adjusted_rate += current_block->rate_delta;
             if (adjusted_rate > current_block->nominal_rate) {  // overshot
@@ -408,12 +489,27 @@ void stepper_handler()
         // cruising
         } else {
           // No accelerations. Make sure we cruise exactly at the nominal rate.
+          // A block entered above its nominal rate after the feed override was
+          // lowered approaches it at the regular acceleration.
           if (adjusted_rate != current_block->nominal_rate) {
-            adjusted_rate = current_block->nominal_rate;
-            adjust_speed( adjusted_rate );
+            if (adjusted_rate + current_block->rate_delta < current_block->nominal_rate) {
+              if ( acceleration_tick() ) {
+                adjusted_rate += current_block->rate_delta;
+                adjust_speed( adjusted_rate );
+              }
+            } else if (adjusted_rate > current_block->nominal_rate + current_block->rate_delta) {
+              if ( acceleration_tick() ) {
+                adjusted_rate -= current_block->rate_delta;
+                adjust_speed( adjusted_rate );
+              }
+            } else {
+              adjusted_rate = current_block->nominal_rate;
+              adjust_speed( adjusted_rate );
+            }
           }
         }
       } else {  // block finished
+        previous_final_rate = current_block->final_rate;
         current_block = NULL;
         planner_discard_current_block();
       }
@@ -447,6 +543,20 @@ void stepper_handler()
 
 
 
+static void record_timing(isr_timing_t *timing, uint32_t ns) {
+  uint32_t us = ns/1000;
+  uint8_t bucket = 0;
+  while (us > 0 && bucket < ISR_HISTOGRAM_SIZE-1) {
+    us >>= 1;
+    bucket++;
+  }
+  timing->histogram[bucket]++;
+  if (ns < timing->min) { timing->min = ns; }
+  if (ns > timing->max) { timing->max = ns; }
+  timing->count++;
+  timing->total += ns/1000;
+}
+
 // This function determines an acceleration velocity change every CYCLES_PER_ACCELERATION_TICK by
 // keeping track of the number of elapsed cycles during a de/ac-celeration. The code assumes that
 // step_events occur significantly more often than the acceleration velocity iterations.
@@ -462,13 +572,16 @@ static bool acceleration_tick() {
 
 static void adjust_speed( uint32_t steps_per_minute ) {
   if (steps_per_minute < MINIMUM_STEPS_PER_MINUTE) { steps_per_minute = MINIMUM_STEPS_PER_MINUTE; }
-	CMT2.CMCOR = ((F_CPU/512)*60)/steps_per_minute;
+  trace_event(TRACE_RATE_CHANGE, min(steps_per_minute/60, 0xFFFF));
+  dev_stepper_period(steps_per_minute);
 
   //cycles_per_step_event = ((CYCLES_PER_MICROSECOND*1000000*60)/steps_per_minute); // these are not the actual nr of cycles.. does his matter?
   cycles_per_step_event = ((CYCLES_PER_MICROSECOND*1000000)/(steps_per_minute/60)); // these are not the actual nr of cycles.. does his matter?
   //
   // run at constant intensity for now
-  control_laser_intensity(current_block->nominal_laser_intensity);
+  if (current_block != NULL) {  // not yet at stepper_init()
+    control_laser_intensity(current_block->nominal_laser_intensity);
+  }
 }
 
 
@@ -556,147 +669,3 @@ void stepper_homing_cycle() {
   approach_limit_switch(true, true, false);
   leave_limit_switch(true, true, false);
 }
-
-//pointers to bitfields dont exist.. thus we use functions...
-void set_STEPPER_X_A1(int val) { STEPPER_X_A1 = val;}
-void set_STEPPER_X_A2(int val) { STEPPER_X_A2 = val;}
-void set_STEPPER_X_B1(int val) { STEPPER_X_B1 = val;}
-void set_STEPPER_X_B2(int val) { STEPPER_X_B2 = val;}
-
-void set_STEPPER_Y_A1(int val) { STEPPER_Y_A1 = val;}
-void set_STEPPER_Y_A2(int val) { STEPPER_Y_A2 = val;}
-void set_STEPPER_Y_B1(int val) { STEPPER_Y_B1 = val;}
-void set_STEPPER_Y_B2(int val) { STEPPER_Y_B2 = val;}
-
-void set_STEPPER_Z_A1(int val) { STEPPER_Z_A1 = val;}
-void set_STEPPER_Z_A2(int val) { STEPPER_Z_A2 = val;}
-void set_STEPPER_Z_B1(int val) { STEPPER_Z_B1 = val;}
-void set_STEPPER_Z_B2(int val) { STEPPER_Z_B2 = val;}
-
-void (*stepper_pins[3][4]) (int val) = {
-		{set_STEPPER_X_A1, set_STEPPER_X_A2, set_STEPPER_X_B1, set_STEPPER_X_B2},
-		{set_STEPPER_Y_A1, set_STEPPER_Y_A2, set_STEPPER_Y_B1, set_STEPPER_Y_B2},
-		{set_STEPPER_Z_A1, set_STEPPER_Z_A2, set_STEPPER_Z_B1, set_STEPPER_Z_B2},
-		};
-
-void do_half_step(int direction, int axis) 
-{
-	static int crrnt_step[3] = {0,0,0};
-
-	
-	if(direction == DIR_FORWARD) {
-		crrnt_step[axis] ++;
-		if (crrnt_step[axis] >= 8)
-			crrnt_step[axis] = 0;
-	}
-	else{
-		if(crrnt_step[axis] == 0)
-			crrnt_step[axis] = 8;
-		crrnt_step[axis] --;			
-	}
-	
-	switch(crrnt_step[axis]) {
-		case 7:
-			stepper_pins[axis][1](0);
-			stepper_pins[axis][3](0);
-			stepper_pins[axis][0](1);
-			stepper_pins[axis][2](1);
-			break;	
-		case 6:
-			stepper_pins[axis][1](0);
-			stepper_pins[axis][3](0);
-			stepper_pins[axis][0](1);
-			stepper_pins[axis][2](0);
-			break;
-		case 5:
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][0] | stepper_pins[axis][3], stepper_pins[axis][1] | stepper_pins[axis][2]);
-			stepper_pins[axis][0](1);
-			stepper_pins[axis][3](1);
-			stepper_pins[axis][1](0);
-			stepper_pins[axis][2](0);
-			break;	
-		case 4:
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][0] | stepper_pins[axis][3], stepper_pins[axis][1] | stepper_pins[axis][2]);
-			stepper_pins[axis][0](0);
-			stepper_pins[axis][3](1);
-			stepper_pins[axis][1](0);
-			stepper_pins[axis][2](0);
-			break;
-		case 3:	
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][2] | stepper_pins[axis][0], stepper_pins[axis][1] | stepper_pins[axis][3]);
-			stepper_pins[axis][0](0);
-			stepper_pins[axis][2](0);
-			stepper_pins[axis][1](1);
-			stepper_pins[axis][3](1);
-			break;	
-		case 2:	
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][2] | stepper_pins[axis][0], stepper_pins[axis][1] | stepper_pins[axis][3]);
-			stepper_pins[axis][0](0);
-			stepper_pins[axis][2](0);
-			stepper_pins[axis][1](1);
-			stepper_pins[axis][3](0);
-			break;
-		case 1:	
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][2], stepper_pins[axis][0] | stepper_pins[axis][3]);
-			stepper_pins[axis][1](1);
-			stepper_pins[axis][2](1);
-			stepper_pins[axis][0](0);
-			stepper_pins[axis][3](0);
-			break;	
-		case 0:	
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][2], stepper_pins[axis][0] | stepper_pins[axis][3]);
-			stepper_pins[axis][1](0);
-			stepper_pins[axis][2](1);
-			stepper_pins[axis][0](0);
-			stepper_pins[axis][3](0);
-			break;
-	}
-}
-
-void do_full_step(int direction, int axis) 
-{
-	static unsigned int crrnt_step[3] = {0,0,0};
-	
-	if(direction == DIR_FORWARD) {
-		crrnt_step[axis] ++;
-		if (crrnt_step[axis] >= 4)
-			crrnt_step[axis] = 0;
-	}
-	else{
-		if(crrnt_step[axis] == 0)
-			crrnt_step[axis] = 4;
-		crrnt_step[axis] --;			
-	}
-	
-	switch(crrnt_step[axis]) {
-		case 0:
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][3], stepper_pins[axis][0] | stepper_pins[axis][2]);
-			stepper_pins[axis][1](1);
-			stepper_pins[axis][3](1);
-			stepper_pins[axis][0](0);
-			stepper_pins[axis][2](0);
-			break;
-		case 1:
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][0] | stepper_pins[axis][3], stepper_pins[axis][1] | stepper_pins[axis][2]);
-			stepper_pins[axis][0](1);
-			stepper_pins[axis][3](1);
-			stepper_pins[axis][1](0);
-			stepper_pins[axis][2](0);
-			break;
-		case 2:	
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][2] | stepper_pins[axis][0], stepper_pins[axis][1] | stepper_pins[axis][3]);
-			stepper_pins[axis][0](1);
-			stepper_pins[axis][2](1);
-			stepper_pins[axis][1](0);
-			stepper_pins[axis][3](0);
-			break;
-		case 3:	
-		//	GPIO_Write(STEPPER_PORT, stepper_pins[axis][1] | stepper_pins[axis][2], stepper_pins[axis][0] | stepper_pins[axis][3]);
-			stepper_pins[axis][1](1);
-			stepper_pins[axis][2](1);
-			stepper_pins[axis][0](0);
-			stepper_pins[axis][3](0);
-			break;
-	}
-}
-
@@ -45,16 +45,67 @@ void stepper_go_idle();
 void stepper_request_stop(uint8_t status);
 bool stepper_stop_requested();
 uint8_t stepper_stop_status();
+
+// decelerate to a controlled stop at the configured acceleration,
+// the remaining blocks stay buffered and the laser is turned off
+void stepper_request_hold();
+
+// clear a stop request and/or continue after a feed hold
 void stepper_resume();
 
-// Get the actual position of the head in mm.
+// The actual position of the head in absolute steps, all axes from the same
+// step, and the dev_timestamp() of that step.
 // This is as accurate as an open loop system can be.
-double stepper_get_position_x();
-double stepper_get_position_y();
-double stepper_get_position_z();
+typedef struct {
+  int32_t steps[3];
+  uint32_t time;
+} stepper_snapshot_t;
+void stepper_get_snapshot(stepper_snapshot_t *snapshot);
+
+// the same in mm, as an array indexed by X_AXIS, Y_AXIS, Z_AXIS
+void stepper_get_position(double *position);
 void stepper_set_position(double x, double y, double z);
 
+// times the block buffer ran dry while the job was still going
+uint16_t stepper_get_starvation_count();
+void stepper_clear_starvation_count();
+
+// what the steppers are doing, for the status report
+#define STEPPER_IDLE 0
+#define STEPPER_RUNNING 1
+#define STEPPER_HOLDING 2  // decelerating for a feed hold or standing in one
+#define STEPPER_STOPPED 3  // stop requested, waiting for stepper_resume()
+uint8_t stepper_get_state();
+
+// feed rate in mm/min right now, 0 when standing still
+double stepper_get_feed_rate();
+
+// g-code line of the block being traced, or of the last one
+uint32_t stepper_get_line_number();
+
+// execution time of the stepper interrupt and its latency after the timer fired
+#define ISR_HISTOGRAM_SIZE 12  // bucket 0 is below 1us, bucket n from 2^(n-1)us, the last open ended
+typedef struct {
+  uint32_t min;    // ns
+  uint32_t max;    // ns
+  uint32_t count;
+  uint32_t total;  // us, for the mean
+  uint32_t histogram[ISR_HISTOGRAM_SIZE];
+} isr_timing_t;
+void stepper_get_isr_timing(isr_timing_t *execution, isr_timing_t *latency);
+void stepper_clear_isr_timing();
+
 // perform the homing cycle
 void stepper_homing_cycle();
 
+// Between the portable stepper.c and the arch's dev_stepper.c. The arch runs a
+// periodic step timer, its interrupt calls stepper_interrupt() while do_int is
+// set and hands the time it took to stepper_record_isr_timing().
+extern volatile int do_int;
+void stepper_interrupt();
+void stepper_record_isr_timing(uint32_t execution_ns, uint32_t latency_ns);
+void dev_stepper_init();                             // set up the pins and start the step timer
+void dev_stepper_period(uint32_t steps_per_minute);  // reload the step timer
+void dev_stepper_pulse(uint8_t out_bits);            // step the axes set in out_bits, see X_STEP_BIT
+
 #endif
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# Sample job for the G2/G3 benchmark, see "make arcs" in tools/Makefile.
+#
+# Writes the same pattern of holes and rounded rectangles twice: once with
+# G2/G3 as it goes on the wire now and once expanded into G1 chords the way
+# the CAM used to do it, at the chord tolerance from config.h.
+#
+#   python3 tools/arc_job.py arcs.gcode lines.gcode
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import os, re, sys, math
+
+
+def config_value(name, default):
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'config.h')
+    try:
+        m = re.search(r'#define\s+%s\s+\(?([-0-9.]+)' % name, open(path).read())
+        if m:
+            return float(m.group(1))
+    except IOError:
+        pass
+    return default
+
+
+TOLERANCE = config_value('CONFIG_ARC_TOLERANCE', 0.01)
+
+
+def chords(cx, cy, r, a0, a1):
+    """Points along the ccw arc from angle a0 to a1, chords within TOLERANCE."""
+    segments = max(1, int(math.ceil((a1 - a0) / (2 * math.acos(1 - TOLERANCE / r)))))
+    for i in range(1, segments + 1):
+        a = a0 + (a1 - a0) * i / segments
+        yield cx + r * math.cos(a), cy + r * math.sin(a)
+
+
+def job():
+    """(x, y, arc) moves, arc is None or (center_x, center_y, radius, start, end)."""
+    for row in range(10):
+        for col in range(10):
+            cx, cy = 20 + col * 40, 20 + row * 30
+            r = 1 + (row * 10 + col) % 12
+            yield 'seek', (cx + r, cy, None)
+            yield 'cut', (cx + r, cy, (cx, cy, r, 0.0, 2 * math.pi))
+    for i in range(20):
+        x0, y0, w, h, r = 10 + i * 20, 320, 15, 60, 3
+        yield 'seek', (x0 + r, y0, None)
+        corners = [(x0 + w - r, y0 + r, -math.pi / 2), (x0 + w - r, y0 + h - r, 0.0),
+                   (x0 + r, y0 + h - r, math.pi / 2), (x0 + r, y0 + r, math.pi)]
+        for cx, cy, a in corners:
+            yield 'cut', (cx + r * math.cos(a), cy + r * math.sin(a), None)
+            yield 'cut', (cx + r * math.cos(a + math.pi / 2), cy + r * math.sin(a + math.pi / 2),
+                          (cx, cy, r, a, a + math.pi / 2))
+
+
+def write(path, expand):
+    out = open(path, 'w')
+    out.write('G21 G90\nS200 F1200\n')
+    x = y = 0.0
+    for kind, (tx, ty, arc) in job():
+        if kind == 'seek':
+            out.write('G0 X%.3f Y%.3f\n' % (tx, ty))
+        elif arc is None:
+            out.write('G1 X%.3f Y%.3f\n' % (tx, ty))
+        elif expand:
+            for px, py in chords(*arc):
+                out.write('G1 X%.3f Y%.3f\n' % (px, py))
+        else:
+            out.write('G3 X%.3f Y%.3f I%.3f J%.3f\n' % (tx, ty, arc[0] - x, arc[1] - y))
+        x, y = tx, ty
+    out.close()
+
+
+if __name__ == '__main__':
+    write(sys.argv[1], False)
+    write(sys.argv[2], True)
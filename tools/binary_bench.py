@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# Throughput benchmark for the binary motion protocol.
+#
+# Generates a synthetic raster job and compares its size and transfer time
+# as g-code and as binary frames. With --port or --tcp both versions are
+# streamed to the controller and the achieved moves per second are reported.
+#
+#   python3 tools/binary_bench.py
+#   python3 tools/binary_bench.py --lines 50 --pixels 400 --port /dev/ttyUSB0
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import sys, time, random, argparse
+import binary_stream as bs
+
+
+def raster_gcode(lines, pixels, pitch, feed):
+    """A bidirectional raster with a random intensity for every pixel."""
+    random.seed(1)
+    out = ["G90", "G0X0Y0", "G1F%d" % feed]
+    for row in range(lines):
+        y = row * pitch
+        cols = range(pixels) if row % 2 == 0 else reversed(range(pixels))
+        for col in cols:
+            out.append("G1X%.3fY%.3fS%d" % (col * pitch, y, random.randint(0, 255)))
+    return [l + "\n" for l in out]
+
+
+def timed_stream(make_channel, frames):
+    channel = make_channel()
+    start = time.time()
+    errors = bs.stream(channel, frames)
+    return time.time() - start, errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description="g-code vs binary raster throughput")
+    parser.add_argument('--lines', type=int, default=100)
+    parser.add_argument('--pixels', type=int, default=200)
+    parser.add_argument('--pitch', type=float, default=0.1, help="mm between pixels")
+    parser.add_argument('--feed', type=int, default=3000)
+    parser.add_argument('--baud', type=int, default=int(bs.config_value('BAUD_RATE', 115200)))
+    parser.add_argument('--port')
+    parser.add_argument('--tcp')
+    args = parser.parse_args()
+
+    gcode = raster_gcode(args.lines, args.pixels, args.pitch, args.feed)
+    moves = args.lines * args.pixels
+    start = time.time()
+    encoder = bs.Encoder(bs.MAX_WIRE_TCP if args.tcp else None)
+    frames = encoder.encode(bs.gcode_moves(gcode, bs.config_value('CONFIG_X_STEPS_PER_MM', 1.0),
+                                           bs.config_value('CONFIG_Y_STEPS_PER_MM', 1.0)))
+    encode_time = time.time() - start
+
+    gcode_bytes = sum(len(l) for l in gcode)
+    binary_bytes = sum(len(f) for f in frames)
+    byte_time = 10.0 / args.baud  # 8N1
+    print("moves:          %d" % moves)
+    print("g-code:         %d bytes, %.1f bytes/move, %.1f s at %d baud"
+          % (gcode_bytes, float(gcode_bytes) / moves, gcode_bytes * byte_time, args.baud))
+    print("binary:         %d bytes, %.1f bytes/move, %.1f s at %d baud, %d frames"
+          % (binary_bytes, float(binary_bytes) / moves, binary_bytes * byte_time, args.baud, len(frames)))
+    print("reduction:      %.1fx" % (float(gcode_bytes) / binary_bytes))
+    print("host encoding:  %.0f moves/s" % (moves / max(encode_time, 1e-9)))
+
+    if args.port or args.tcp:
+        make_channel = (lambda: bs.SerialChannel(args.port)) if args.port else (lambda: bs.TcpChannel(args.tcp))
+        # g-code goes through the same character counting, one line per "ok"
+        t, e = timed_stream(make_channel, [l.encode() for l in gcode])
+        print("streamed g-code: %.1f s, %.0f moves/s, %d errors" % (t, moves / t, e))
+        t, e = timed_stream(make_channel, frames)
+        print("streamed binary: %.1f s, %.0f moves/s, %d errors" % (t, moves / t, e))
+
+
+if __name__ == '__main__':
+    main()
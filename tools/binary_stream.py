@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+# Host side of the LasaurGrbl binary motion protocol.
+#
+# Converts the G0/G1 moves of a g-code file into binary frames (see binary.h)
+# and either writes them to a file or streams them to the controller.
+#
+#   python3 tools/binary_stream.py job.gcode -o job.bin
+#   python3 tools/binary_stream.py job.gcode --port /dev/ttyUSB0
+#   python3 tools/binary_stream.py job.gcode --tcp 192.168.0.10
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import os, re, sys, struct, socket, argparse
+
+
+SOF = 0x02
+ESC = 0x7d
+ESC_XOR = 0x20
+WHITEN = 0x40
+TYPE_FEED = 0x01
+TYPE_MOVES = 0x02
+FEED_TABLE_SIZE = 16
+
+# bytes that must never appear raw in a frame: line ends, NUL, SERIAL_NO_DATA
+# and telnet IAC (0xff), flow control, real-time commands and the framing itself
+RESERVED = set([0x00, 0x0a, 0x0d, 0xff, 0x11, 0x13, ord('?'), ord('!'), ord('~'), 0x18,
+                0x90, 0x91, 0x92, 0x93, 0x94, SOF, ESC])
+
+MAX_FRAME = 80       # BUFFER_FRAME_SIZE in gcode.c, unescaped
+MAX_WIRE_TCP = 38    # TELNETD_CONF_LINELEN-2, the telnet shell splits longer lines
+RX_BUFFER_SIZE = 2048
+
+
+def config_value(name, default):
+    """Read a numeric #define from config.h so steps/mm stay in sync with the firmware."""
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'config.h')
+    try:
+        m = re.search(r'#define\s+%s\s+\(?([-0-9.]+)' % name, open(path).read())
+        if m:
+            return float(m.group(1))
+    except IOError:
+        pass
+    return default
+
+
+def crc16(data):
+    crc = 0xffff
+    for b in data:
+        crc ^= b << 8
+        for i in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xffff
+            else:
+                crc = (crc << 1) & 0xffff
+    return crc
+
+
+def escape(data):
+    out = bytearray()
+    for b in data:
+        b ^= WHITEN
+        if b in RESERVED:
+            out.append(ESC)
+            out.append(b ^ ESC_XOR)
+        else:
+            out.append(b)
+    return bytes(out)
+
+
+def varint(value):
+    """Zigzag varint as read by read_varint() in binary.c"""
+    raw = (value << 1) ^ (value >> 31)
+    raw &= 0xffffffff
+    out = bytearray()
+    while raw > 0x7f:
+        out.append((raw & 0x7f) | 0x80)
+        raw >>= 7
+    out.append(raw)
+    return bytes(out)
+
+
+class Encoder:
+    def __init__(self, max_wire=None):
+        self.sequence = 0
+        self.max_wire = max_wire
+        self.feeds = {}  # feed rate -> table index
+
+    def frame(self, type, payload):
+        body = bytes([self.sequence & 0xff, type]) + payload
+        body += struct.pack('<H', crc16(body))
+        self.sequence += 1
+        return bytes([SOF]) + escape(body) + b'\n'
+
+    def fits(self, type, payload):
+        if len(payload) + 4 > MAX_FRAME:
+            return False
+        if self.max_wire is None:
+            return True
+        body = bytes([self.sequence & 0xff, type]) + payload
+        body += struct.pack('<H', crc16(body))
+        return len(escape(body)) + 2 <= self.max_wire
+
+    def feed_index(self, feed, frames):
+        """Map a feed rate to a table slot, emitting a feed frame when it is new."""
+        if feed <= 0:
+            raise ValueError("feed rate %g, must be > 0" % feed)
+        feed = max(1, int(round(feed)))  # binary.c rejects a feed of 0
+        if feed not in self.feeds:
+            if len(self.feeds) >= FEED_TABLE_SIZE:
+                raise ValueError("more than %d distinct feed rates" % FEED_TABLE_SIZE)
+            index = len(self.feeds)
+            self.feeds[feed] = index
+            frames.append(self.frame(TYPE_FEED, struct.pack('<BH', index, feed)))
+        return self.feeds[feed]
+
+    def encode(self, moves):
+        """moves: iterable of (dx_steps, dy_steps, feed, intensity). Returns a list of wire frames."""
+        frames = []
+        payload = None
+        index = None
+        for dx, dy, feed, intensity in moves:
+            i = self.feed_index(feed, frames)
+            move = varint(dx) + varint(dy) + bytes([intensity & 0xff])
+            if payload is not None and (i != index or not self.fits(TYPE_MOVES, payload + move)):
+                frames.append(self.frame(TYPE_MOVES, payload))
+                payload = None
+            if payload is None:
+                payload = bytes([i])
+                index = i
+            payload += move
+        if payload is not None:
+            frames.append(self.frame(TYPE_MOVES, payload))
+        return frames
+
+
+def gcode_moves(lines, x_steps_per_mm, y_steps_per_mm):
+    """Step deltas for the absolute G0/G1 XY moves of a g-code job.
+    Deltas are taken between rounded absolute targets so nothing accumulates."""
+    feed = config_value('CONFIG_FEEDRATE', 1500.0)
+    intensity = 0
+    x = y = 0.0
+    px = py = 0
+    for line in lines:
+        line = re.sub(r'\(.*?\)|;.*', '', line).upper()
+        words = dict((w[0], float(w[1:])) for w in re.findall(r'[A-Z][-+0-9.]+', line))
+        if 'F' in words:
+            feed = words['F']
+        if 'S' in words:
+            intensity = int(words['S'])
+        if words.get('G') not in (0.0, 1.0) or not ('X' in words or 'Y' in words):
+            continue
+        x = words.get('X', x)
+        y = words.get('Y', y)
+        tx = int(round(x * x_steps_per_mm))
+        ty = int(round(y * y_steps_per_mm))
+        yield (tx - px, ty - py, feed, intensity if words['G'] == 1.0 else 0)
+        px, py = tx, ty
+
+
+def stream(channel, frames):
+    """Send frames while keeping the controller's receive buffer full (character counting)."""
+    pending = []
+    received = b''
+    errors = 0
+    for frame in frames + [None]:
+        while pending and (frame is None or sum(pending) + len(frame) >= RX_BUFFER_SIZE):
+            received += channel.read()
+            while b'\n' in received:
+                reply, received = received.split(b'\n', 1)
+                reply = reply.strip()
+                if reply.startswith(b'Error'):
+                    errors += 1
+                    sys.stderr.write(reply.decode(errors='replace') + '\n')
+                if reply == b'ok' or reply.startswith(b'Error'):
+                    pending.pop(0)
+        if frame is not None:
+            channel.write(frame)
+            pending.append(len(frame))
+    return errors
+
+
+class SerialChannel:
+    def __init__(self, port):
+        import serial
+        self.port = serial.Serial(port, int(config_value('BAUD_RATE', 115200)), timeout=1)
+
+    def write(self, data):
+        self.port.write(data)
+
+    def read(self):
+        return self.port.read(max(1, self.port.in_waiting))
+
+
+class TcpChannel:
+    def __init__(self, host, port=23):
+        self.sock = socket.create_connection((host, port))
+        self.sock.sendall(b'grbl\n')  # leave the shell, see shell.c
+
+    def write(self, data):
+        self.sock.sendall(data)
+
+    def read(self):
+        return self.sock.recv(1024)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="encode g-code moves as binary frames")
+    parser.add_argument('gcode')
+    parser.add_argument('-o', '--output', help="write frames to a file")
+    parser.add_argument('--port', help="stream to a serial port")
+    parser.add_argument('--tcp', help="stream to the telnet shell at this host")
+    args = parser.parse_args()
+
+    encoder = Encoder(MAX_WIRE_TCP if args.tcp else None)
+    moves = gcode_moves(open(args.gcode), config_value('CONFIG_X_STEPS_PER_MM', 1.0),
+                        config_value('CONFIG_Y_STEPS_PER_MM', 1.0))
+    frames = encoder.encode(moves)
+    sys.stderr.write("%d frames, %d bytes\n" % (len(frames), sum(len(f) for f in frames)))
+
+    if args.output:
+        open(args.output, 'wb').write(b''.join(frames))
+    if args.port or args.tcp:
+        channel = SerialChannel(args.port) if args.port else TcpChannel(args.tcp)
+        sys.exit(1 if stream(channel, frames) else 0)
+
+
+if __name__ == '__main__':
+    main()
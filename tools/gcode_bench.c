@@ -0,0 +1,187 @@
+/*
+  gcode_bench.c - host benchmark for the g-code parser
+  Part of LasaurGrbl
+
+  Runs gcode_execute_line() over a corpus of g-code files and reports the
+  parse rate. Built twice by tools/Makefile, once as is and once with
+  GCODE_STRTOD where every number goes through strtod(). With -o both write
+  the resulting planner targets as hex doubles so they can be compared
+  bit by bit.
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "gcode.h"
+#include "planner.h"
+#include "stepper.h"
+
+#define RAW_SIZE 160  // for the synthetic corpus, file lines can be any length
+
+static char **lines;
+static int line_count;
+static int line_capacity;
+static FILE *dump;
+static uint32_t lines_planned;
+
+
+//// stubs for everything gcode.c needs from the rest of the firmware
+
+static void dump_double(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  fprintf(dump, "%016llx ", (unsigned long long)bits);
+}
+
+void planner_line(double x, double y, double z, double feed_rate, uint8_t nominal_laser_intensity) {
+  lines_planned++;
+  if (dump) {
+    dump_double(x);
+    dump_double(y);
+    dump_double(z);
+    dump_double(feed_rate);
+    fprintf(dump, "%u\n", nominal_laser_intensity);
+  }
+}
+void planner_line_relative_steps(int32_t dx, int32_t dy, int32_t dz, double feed_rate, uint8_t nominal_laser_intensity) {}
+void planner_dwell(double seconds, uint8_t nominal_laser_intensity) {}
+void planner_command(uint8_t type) {}
+void planner_set_position(double x, double y, double z) {}
+void planner_get_position(double *target) { target[0] = target[1] = target[2] = 0.0; }
+void planner_set_feed_override(uint8_t percent) {}
+uint8_t planner_get_feed_override() { return 100; }
+void planner_set_blend_tolerance(double tolerance) {}
+void printString(const char *s) {}
+void printPgmString(const char *s) {}
+void printInteger(long n) {}
+void printFloat(double n) {}
+uint8_t serial_read() { return 0xff; }
+void serial_wait(uint16_t timeout_ms) {}
+void serial_reset_read_buffer() {}
+void stepper_get_position(double *position) { position[0] = position[1] = position[2] = 0.0; }
+void stepper_get_snapshot(stepper_snapshot_t *snapshot) { memset(snapshot, 0, sizeof(stepper_snapshot_t)); }
+void stepper_homing_cycle() {}
+void stepper_request_hold() {}
+void stepper_request_stop(uint8_t status) {}
+void stepper_resume() {}
+bool stepper_stop_requested() { return false; }
+uint8_t stepper_stop_status() { return 0; }
+void stepper_synchronize() {}
+uint16_t stepper_get_starvation_count() { return 0; }
+void stepper_clear_starvation_count() {}
+void trace_event(uint8_t type, uint16_t arg) {}
+uint8_t stepper_get_state() { return STEPPER_IDLE; }
+double stepper_get_feed_rate() { return 0.0; }
+uint32_t stepper_get_line_number() { return 0; }
+uint16_t serial_available() { return 0; }
+uint16_t serial_get_overrun_count() { return 0; }
+uint8_t control_get_laser_intensity() { return 0; }
+uint8_t planner_blocks_queued() { return 0; }
+void planner_set_line_number(uint32_t line_number) {}
+void stepper_get_isr_timing(isr_timing_t *execution, isr_timing_t *latency) { memset(execution, 0, sizeof(isr_timing_t)); memset(latency, 0, sizeof(isr_timing_t)); }
+bool dev_memory_headroom(uint32_t *stack_free, uint32_t *heap_free) { return false; }
+
+
+// Same normalization as protocol_process(): drop whitespace, control
+// characters and (comments), upcase.
+static void add_line(const char *raw) {
+  char *line = malloc(strlen(raw) + 1);
+  int n = 0;
+  int iscomment = 0;
+  for (; *raw; raw++) {
+    char c = *raw;
+    if (iscomment) {
+      if (c == ')') { iscomment = 0; }
+    } else if (c <= ' ' || c == '/') {
+    } else if (c == '(') {
+      iscomment = 1;
+    } else {
+      line[n++] = (c >= 'a' && c <= 'z') ? c-'a'+'A' : c;
+    }
+  }
+  if (n == 0) { free(line); return; }
+  line[n] = 0;
+  if (line_count == line_capacity) {
+    line_capacity = line_capacity ? 2*line_capacity : 4096;
+    lines = realloc(lines, line_capacity * sizeof(char *));
+  }
+  lines[line_count++] = line;
+}
+
+static void load(const char *path) {
+  char *raw = NULL;
+  size_t size = 0;
+  FILE *f = fopen(path, "r");
+  if (!f) { perror(path); exit(1); }
+  while (getline(&raw, &size, f) != -1) { add_line(raw); }
+  free(raw);
+  fclose(f);
+}
+
+// Deterministic stand-in when no corpus is given: a raster and some vector paths
+static void synthesize() {
+  char raw[RAW_SIZE];
+  int row, col, i;
+  srand(1);
+  add_line("G21 G90 G54");
+  for (row = 0; row < 200; row++) {
+    snprintf(raw, sizeof(raw), "G0 X0 Y%.3f", row * 0.1);
+    add_line(raw);
+    for (col = 0; col < 400; col++) {
+      snprintf(raw, sizeof(raw), "G1 X%.3f S%d", col * 0.1 + 0.1, rand() % 256);
+      add_line(raw);
+    }
+  }
+  for (i = 0; i < 50000; i++) {
+    snprintf(raw, sizeof(raw), "G1 X%.4f Y%.4f F%d S255", (rand() % 6000000) / 10000.0,
+             (rand() % 4000000) / 10000.0, 1000 + 500 * (i / 10000));
+    add_line(raw);
+  }
+}
+
+int main(int argc, char **argv) {
+  int repeat = 10;
+  int i, r;
+  int errors = 0;
+  struct timespec start, end;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i+1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-o") && i+1 < argc) {
+      dump = fopen(argv[++i], "w");
+      repeat = 1;
+    } else {
+      load(argv[i]);
+    }
+  }
+  if (line_count == 0) { synthesize(); }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (r = 0; r < repeat; r++) {
+    gcode_init();
+    for (i = 0; i < line_count; i++) {
+      if (gcode_execute_line(lines[i]) != STATUS_OK && r == 0) { errors++; }
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  double total = (double)line_count * repeat;
+  printf("%s: %d lines x %d, %d errors, %u moves, %.0f lines/s, %.1f ns/line\n",
+#ifdef GCODE_STRTOD
+         "strtod",
+#else
+         "fast",
+#endif
+         line_count, repeat, errors, lines_planned / repeat, total / seconds, seconds * 1e9 / total);
+  if (dump) { fclose(dump); }
+  return 0;
+}
@@ -0,0 +1,218 @@
+/*
+  job_time.c - job time estimate from the firmware's own parser and planner
+  Part of LasaurGrbl
+
+  Feeds a g-code file through protocol_process() and the planner exactly as
+  the controller would, with the stepper replaced by a model of its speed
+  profile. Each block is timed from the trapezoid the planner left in it once
+  it leaves the buffer, ie: with the same look-ahead as on the machine.
+
+    tools/build/job_time job.gcode [job2.gcode ...]
+
+  Reports the total time, split into laser off (travel) and laser on (cut),
+  and the motion lines that execute faster than they can be sent at BAUD_RATE.
+  A run of those drains the block buffer, see CONFIG_SLOWDOWN_* in config.h.
+  The estimate assumes the link keeps up, it does not model the slowdown.
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "gcode.h"
+#include "planner.h"
+#include "serial.h"
+#include "stepper.h"
+#include "config.h"
+
+#define BITS_PER_BYTE 10  // start, 8 data, stop
+
+static char *input;          // the whole job
+static size_t input_length;
+static size_t input_pos;
+static uint32_t line;        // line being parsed, from 0
+
+static uint32_t *line_bytes; // per line: bytes on the wire
+static double *line_time;    // per line: execution time of its blocks in minutes
+static uint8_t *line_blocks; // per line: blocks planned, saturates
+static uint32_t line_capacity;
+
+// line of each block in the ring, in the order they were planned
+#define FIFO_SIZE 256  // more than BLOCK_BUFFER_SIZE
+static uint32_t fifo[FIFO_SIZE];
+static uint32_t fifo_head, fifo_tail;
+
+static double total_off, total_on;  // minutes
+static uint32_t blocks;
+
+
+//// the stepper: time the oldest block in the buffer and discard it
+
+// Minutes the stepper takes for a block. Like stepper.c it accelerates by rate_delta
+// per acceleration tick, never goes below MINIMUM_STEPS_PER_MINUTE, and does not
+// decelerate below final_rate.
+static double block_minutes(block_t *block) {
+  double a = (double)block->rate_delta * ACCELERATION_TICKS_PER_SECOND * 60;  // steps/min^2
+  double n = block->step_event_count;
+  double accelerate = block->accelerate_until;
+  double decelerate = n - block->decelerate_after;
+  double cruise = block->decelerate_after - block->accelerate_until;
+  double vi = max(block->initial_rate, MINIMUM_STEPS_PER_MINUTE);
+  double vf = max(block->final_rate, MINIMUM_STEPS_PER_MINUTE);
+  double vn = max(block->nominal_rate, MINIMUM_STEPS_PER_MINUTE);
+  double vp = min(vn, sqrt(vi*vi + 2*a*accelerate));  // reached at accelerate_until
+  double minutes = 0.0;
+  double s;
+  if (accelerate > 0) { minutes += 2*accelerate/(vi+vp); }
+  if (cruise > 0) { minutes += cruise/vp; }
+  if (decelerate > 0) {
+    s = vp > vf ? (vp*vp - vf*vf)/(2*a) : 0;  // steps to get down to final_rate
+    if (s >= decelerate) {
+      minutes += 2*decelerate/(vp + sqrt(vp*vp - 2*a*decelerate));
+    } else {
+      minutes += 2*s/(vp+vf) + (decelerate-s)/vf;
+    }
+  }
+  return minutes;
+}
+
+static void consume() {
+  block_t *block = planner_get_current_block();
+  if (block == NULL) { return; }
+  if (block->type == TYPE_LINE) {
+    double minutes = block_minutes(block);
+    if (block->nominal_laser_intensity > 0) { total_on += minutes; }
+    else { total_off += minutes; }
+    line_time[fifo[fifo_tail % FIFO_SIZE]] += minutes;
+    blocks++;
+  }
+  fifo_tail++;
+  planner_discard_current_block();
+}
+
+// the planner waits here while the buffer is full
+void sleep_mode() { consume(); }
+
+// called once for every block the planner adds
+void stepper_wake_up() {
+  fifo[fifo_head++ % FIFO_SIZE] = line;
+  if (line_blocks[line] < 255) { line_blocks[line]++; }
+}
+
+void stepper_get_position(double *position) { position[0] = position[1] = position[2] = 0.0; }
+void stepper_get_snapshot(stepper_snapshot_t *snapshot) { memset(snapshot, 0, sizeof(stepper_snapshot_t)); }
+void stepper_homing_cycle() {}
+void stepper_request_hold() {}
+void stepper_request_stop(uint8_t status) {}
+void stepper_resume() {}
+bool stepper_stop_requested() { return false; }
+uint8_t stepper_stop_status() { return 0; }
+void stepper_synchronize() { while (planner_blocks_available()) { consume(); } }
+uint16_t stepper_get_starvation_count() { return 0; }
+void stepper_clear_starvation_count() {}
+void trace_event(uint8_t type, uint16_t arg) {}
+uint8_t stepper_get_state() { return STEPPER_IDLE; }
+double stepper_get_feed_rate() { return 0.0; }
+uint32_t stepper_get_line_number() { return 0; }
+uint16_t serial_available() { return 0; }
+uint16_t serial_get_overrun_count() { return 0; }
+uint8_t control_get_laser_intensity() { return 0; }
+void stepper_get_isr_timing(isr_timing_t *execution, isr_timing_t *latency) { memset(execution, 0, sizeof(isr_timing_t)); memset(latency, 0, sizeof(isr_timing_t)); }
+bool dev_memory_headroom(uint32_t *stack_free, uint32_t *heap_free) { return false; }
+
+
+//// the serial port: the job, one byte at a time
+
+uint8_t serial_read() {
+  uint8_t c;
+  if (input_pos == input_length) { return SERIAL_NO_DATA; }
+  c = input[input_pos++];
+  line_bytes[line]++;
+  if (c == '\n') { line++; }
+  return c;
+}
+
+void serial_wait(uint16_t timeout_ms) {}
+void serial_reset_read_buffer() {}
+void printString(const char *s) {}
+void printPgmString(const char *s) {}
+void printInteger(long n) {}
+void printFloat(double n) {}
+
+
+static void load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  long size;
+  size_t i;
+  if (!f) { perror(path); exit(1); }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  input = realloc(input, input_length + size + 1);
+  if (fread(input + input_length, 1, size, f) != (size_t)size) { perror(path); exit(1); }
+  fclose(f);
+  input_length += size;
+  if (input_length == 0 || input[input_length-1] != '\n') { input[input_length++] = '\n'; }
+  line_capacity = 1;
+  for (i = 0; i < input_length; i++) {
+    if (input[i] == '\n') { line_capacity++; }
+  }
+}
+
+static void print_time(const char *label, double minutes) {
+  double seconds = minutes * 60;
+  printf("%-10s %4d:%02d:%05.2f  %10.2f s\n", label, (int)(seconds/3600), 
+         (int)fmod(seconds/60, 60), fmod(seconds, 60), seconds);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, end;
+  uint32_t i, lines = 0, prone = 0;
+  uint64_t bytes = 0;
+  double seconds;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s job.gcode [job2.gcode ...]\n", argv[0]);
+    return 2;
+  }
+  for (i = 1; i < (uint32_t)argc; i++) { load(argv[i]); }
+  line_bytes = calloc(line_capacity, sizeof(uint32_t));
+  line_time = calloc(line_capacity, sizeof(double));
+  line_blocks = calloc(line_capacity, sizeof(uint8_t));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  planner_init();
+  gcode_init();
+  while (input_pos < input_length) {
+    gcode_process_line();
+  }
+  stepper_synchronize();
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  // a line is starvation-prone when its moves take less time than sending it,
+  // along with the lines before it that did not move (eg: shorter than a step)
+  for (i = 0; i < line; i++) {
+    bytes += line_bytes[i];
+    if (line_blocks[i] > 0) {
+      lines++;
+      if (line_time[i]*60 < (double)bytes*BITS_PER_BYTE/BAUD_RATE) { prone++; }
+      bytes = 0;
+    }
+  }
+
+  print_time("total", total_off + total_on);
+  print_time("laser off", total_off);
+  print_time("laser on", total_on);
+  printf("%u motion lines, %u blocks, %u starvation-prone lines (faster than %d baud)\n",
+         lines, blocks, prone, BAUD_RATE);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  fprintf(stderr, "%u lines in %.3f s, %.0f lines/s\n", line, seconds, line / seconds);
+  return 0;
+}
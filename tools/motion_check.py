@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Runs a corpus of jobs through the simulator and records what the motion
+# came out as, to compare a planner or stepper change against the tree before.
+#
+#   python3 tools/motion_check.py run before.txt     (on the old tree)
+#   python3 tools/motion_check.py run after.txt      (on the new tree)
+#   python3 tools/motion_check.py compare before.txt after.txt
+#
+# "make motion" in tools/ does the run into build/motion.txt and compares it
+# with tools/motion.txt, the reference committed with the tree, or with
+# BASELINE=file when given, and fails on a difference. A change meant to move
+# the motion commits the new build/motion.txt as motion.txt along with it.
+# run builds the simulator (make ARCH=simulator).
+#
+# Per job one line: the steps taken per axis, the final position, the simulated
+# time and a hash of the step timeline (every step with its time, direction
+# and laser intensity). compare fails when a position, a step count or the
+# timeline changed, and lists the time difference of every job, so a change
+# meant to be a pure speedup shows as identical and a motion change shows by
+# how much it moves the job time.
+#
+# The corpus is generated, not stored:
+#   vector  outlines as G1 chords (arc_job.py expanded)
+#   arcs    G2/G3 both ways, as I/J and R, full circles and helices
+#   splines G5 curves (spline_job.py)
+#   raster  bidirectional 0.1 mm pixels with varying intensity (binary_bench.py)
+#   tiny    a spiral of 0.02 mm segments
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import os, re, sys, math, hashlib, subprocess, tempfile
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(TOOLS, '..')
+SIMULATOR = os.path.join(ROOT, 'build', 'grbl-simulator.elf')
+sys.path.insert(0, TOOLS)
+
+
+def tiny_segments(path):
+    out = open(path, 'w')
+    out.write('G21 G90\nG0 X50 Y50\nS180 F600\n')
+    angle, radius = 0.0, 1.0
+    while radius < 20:
+        angle += 0.02 / radius
+        radius = 1.0 + angle * 0.5
+        out.write('G1 X%.4f Y%.4f\n' % (50 + radius * math.cos(angle), 50 + radius * math.sin(angle)))
+    out.close()
+
+
+def arcs(path):
+    # G2/G3 only, not the vector job's outlines: both directions, I/J and R,
+    # negative R for the long way round, full circles and a helix in Z
+    out = open(path, 'w')
+    out.write('G21 G90\nS200 F1200\n')
+    for row in range(6):
+        for col in range(8):
+            cx, cy = 30 + col * 45, 30 + row * 45
+            r = 3 + (row * 8 + col) % 15
+            out.write('G0 X%.3f Y%.3f Z0\n' % (cx + r, cy))
+            out.write('G3 X%.3f Y%.3f R%.3f\n' % (cx - r, cy, r))
+            out.write('G2 X%.3f Y%.3f I%.3f J0\n' % (cx, cy + r, r))
+            out.write('G3 X%.3f Y%.3f R%.3f\n' % (cx + r, cy, -r))
+            out.write('G2 X%.3f Y%.3f Z%.3f I%.3f J0\n' % (cx + r, cy, 1 + row * 0.5, -r))
+    out.close()
+
+
+def corpus(directory):
+    """(name, path) of the generated jobs."""
+    import arc_job, spline_job, binary_bench
+    jobs = [('vector', lambda p: arc_job.write(p, True)),
+            ('arcs', arcs),
+            ('splines', lambda p: spline_job.write(p, False)),
+            ('raster', lambda p: open(p, 'w').writelines(binary_bench.raster_gcode(20, 200, 0.1, 3000))),
+            ('tiny', tiny_segments)]
+    for name, write in jobs:
+        path = os.path.join(directory, name + '.gcode')
+        write(path)
+        yield name, path
+
+
+def run_job(path, trace):
+    result = subprocess.run([SIMULATOR, '-t', trace, path], stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, universal_newlines=True, check=True)
+    m = re.search(r'simulated ([0-9.]+) s, position X([-0-9.]+) Y([-0-9.]+) Z([-0-9.]+)', result.stderr)
+    if not m:
+        sys.exit('%s: no summary from the simulator:\n%s' % (path, result.stderr))
+    steps = [0, 0, 0]
+    digest = hashlib.sha1()
+    with open(trace, 'rb') as f:
+        f.readline()
+        for line in f:
+            digest.update(line)
+            for i, s in enumerate(line.split(b',')[1:4]):
+                steps[i] += abs(int(s))
+    return steps, m.group(2, 3, 4), m.group(1), digest.hexdigest()[:16]
+
+
+def run(output):
+    subprocess.run(['make', '-s', '-C', ROOT, 'ARCH=simulator'], check=True)
+    with tempfile.TemporaryDirectory() as directory, open(output, 'w') as out:
+        trace = os.path.join(directory, 'trace.csv')
+        for name, path in corpus(directory):
+            steps, position, seconds, digest = run_job(path, trace)
+            line = '%-8s %d %d %d %s %s %s %s %s' % ((name,) + tuple(steps) + position + (seconds, digest))
+            out.write(line + '\n')
+            print(line)
+
+
+def read(path):
+    jobs = {}
+    for line in open(path):
+        f = line.split()
+        jobs[f[0]] = {'steps': f[1:4], 'position': f[4:7], 'time': float(f[7]), 'hash': f[8]}
+    return jobs
+
+
+def compare(before_path, after_path):
+    before, after = read(before_path), read(after_path)
+    failed = False
+    for name in before:
+        if name not in after:
+            print('%-8s missing' % name)
+            failed = True
+            continue
+        b, a = before[name], after[name]
+        delta = (a['time'] - b['time']) / b['time'] * 100 if b['time'] else 0.0
+        if b['steps'] != a['steps'] or b['position'] != a['position']:
+            state = 'DIFFERENT POSITION'
+            failed = True
+        elif b['hash'] != a['hash']:
+            state = 'different timeline'
+            failed = True
+        else:
+            state = 'identical'
+        print('%-8s %-18s %9.3f s -> %9.3f s (%+.2f%%)' % (name, state, b['time'], a['time'], delta))
+    return 1 if failed else 0
+
+
+def main():
+    if len(sys.argv) == 3 and sys.argv[1] == 'run':
+        run(sys.argv[2])
+    elif len(sys.argv) == 4 and sys.argv[1] == 'compare':
+        sys.exit(compare(sys.argv[2], sys.argv[3]))
+    else:
+        sys.exit('usage: motion_check.py run out.txt | compare before.txt after.txt')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Static RAM per module, read from the linker map.
+#
+#   make ARCH=rx62n      writes build/grbl-rx62n.map, the simulator its own
+#   python3 tools/ram_map.py build/grbl-rx62n.map [--ram-size 96k] [--members]
+#
+# Sums the .data and .bss input sections (COMMON included) of every object
+# file and prints them largest first. Objects from a library are counted
+# under the library, --members lists them one by one. The task stacks and
+# the pools of mem_pool.c are static too and show up under mem_pool.o; what
+# they leave unused is reported by the shell commands stack and mem.
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import re, sys
+
+# output sections that end up in RAM
+RAM_SECTIONS = ('.data', '.bss', '.sdata', '.sbss', '.noinit', '.dynbss')
+
+OUTPUT = re.compile(r'^(\.[\w.]+)\b')
+INPUT = re.compile(r'^ (\S+)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)(?:\s+(.+))?)?$')
+WRAPPED = re.compile(r'^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(.+)$')
+
+
+def in_ram(section):
+    return any(section == s or section.startswith(s + '.') for s in RAM_SECTIONS)
+
+
+def module(path, members):
+    """The object file, or the library it came from."""
+    m = re.match(r'(.*)\((.*)\)$', path)
+    if m:
+        library = m.group(1).split('/')[-1]
+        return '%s(%s)' % (library, m.group(2)) if members else library
+    return path.split('/')[-1]
+
+
+def read(path, members):
+    """{module: [data bytes, bss bytes]} of the RAM output sections."""
+    sizes = {}
+    output, pending = None, None
+    started = False
+    for line in open(path):
+        line = line.rstrip()
+        if line.startswith('Linker script and memory map'):
+            started = True
+            continue
+        if not started:
+            continue
+        m = OUTPUT.match(line)
+        if m:
+            output, pending = m.group(1), None
+            continue
+        if output is None or not in_ram(output):
+            continue
+        m = INPUT.match(line)
+        if m and not m.group(1).startswith('0x') and not m.group(1).startswith('*('):
+            if m.group(2) is None:
+                pending = m.group(1)  # name too long, address and size follow
+                continue
+            section, size, obj = m.group(1), m.group(3), m.group(4) or ''
+        else:
+            m = WRAPPED.match(line)
+            if not (m and pending):
+                continue
+            section, size, obj = pending, m.group(2), m.group(3)
+        pending = None
+        if section == '*fill*' or not obj:
+            obj = 'alignment'
+        kind = 1 if 'bss' in output else 0
+        entry = sizes.setdefault(module(obj.strip(), members), [0, 0])
+        entry[kind] += int(size, 16)
+    return sizes
+
+
+def size_arg(text):
+    text = text.lower()
+    scale = 1024 if text.endswith('k') else 1
+    return int(text.rstrip('k'), 0) * scale
+
+
+def main(args):
+    members = '--members' in args
+    args = [a for a in args if a != '--members']
+    ram_size = None
+    if '--ram-size' in args:
+        i = args.index('--ram-size')
+        ram_size = size_arg(args[i + 1])
+        del args[i:i + 2]
+    if len(args) != 1:
+        sys.exit('usage: ram_map.py <map file> [--ram-size 96k] [--members]')
+
+    sizes = read(args[0], members)
+    rows = sorted(sizes.items(), key=lambda kv: -(kv[1][0] + kv[1][1]))
+    width = max([len('module')] + [len(name) for name, _ in rows])
+    print('%-*s %7s %7s %7s' % (width, 'module', 'data', 'bss', 'total'))
+    data = bss = 0
+    for name, (d, b) in rows:
+        if d + b == 0:
+            continue
+        print('%-*s %7d %7d %7d' % (width, name, d, b, d + b))
+        data += d
+        bss += b
+    print('%-*s %7d %7d %7d' % (width, 'total', data, bss, data + bss))
+    if ram_size:
+        print('%d of %d bytes, %.1f%% of the RAM, %d left for the main stack'
+              % (data + bss, ram_size, 100.0 * (data + bss) / ram_size, ram_size - data - bss))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+# Short g-code scenarios run through the simulator, each checked against the
+# responses it should get and where the machine should end up.
+#
+#   python3 tools/sim_test.py          ("make test" in tools/)
+#
+# Builds the simulator (make ARCH=simulator), prints a line per scenario and
+# exits non-zero when any of them fails.
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import os, re, sys, struct, subprocess, tempfile
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, TOOLS)
+import motion_check
+import binary_stream
+
+STEPS_PER_MM_X = binary_stream.config_value('CONFIG_X_STEPS_PER_MM', 1.0)
+POSITION = re.compile(r'position X([-0-9.]+) Y([-0-9.]+) Z([-0-9.]+)')
+
+
+def simulate(job, options=()):
+    """(response lines, final position) of a job given as a string or bytes."""
+    with tempfile.NamedTemporaryFile('wb' if isinstance(job, bytes) else 'w', suffix='.gcode') as f:
+        f.write(job)
+        f.flush()
+        result = subprocess.run([motion_check.SIMULATOR] + list(options) + [f.name],
+                                stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                universal_newlines=True, check=True)
+    m = POSITION.search(result.stderr)
+    if not m:
+        raise AssertionError('no summary from the simulator:\n' + result.stderr)
+    return result.stdout.splitlines(), tuple(float(v) for v in m.groups())
+
+
+def expect(condition, message):
+    if not condition:
+        raise AssertionError(message)
+
+
+def arc_without_center():
+    # like grbl, a G2/G3 with neither R nor I/J/K is an error, not a straight line
+    start = 'G21 G90\nG1 X5 Y5 F600\n'
+    _, at_start = simulate(start)
+    lines, position = simulate(start + 'G2 X10 Y5\nG3 X10 Y5\n')
+    errors = [l for l in lines if l.startswith('Error')]
+    expect(errors == ['Error: Unsupported statement'] * 2, 'responses %s' % errors)
+    expect(position == at_start, 'moved from %s to %s' % (at_start, position))
+    lines, position = simulate(start + 'G2 X10 Y5 I2.5\nG3 X5 Y5 R2.5\n')
+    expect(not any(l.startswith('Error') for l in lines), 'responses %s' % lines)
+    expect(position == at_start, 'arcs from %s ended at %s' % (at_start, position))
+
+
+def status_reports(lines):
+    """(state, {field: value}) of every status report among the responses."""
+    reports = []
+    for line in lines:
+        fields = line.split()
+        if fields and fields[0] in ('Idle', 'Run', 'Hold', 'Stop'):
+            reports.append((fields[0], dict(f.split(':', 1) for f in fields[1:])))
+    return reports
+
+
+def hold_resume_feed():
+    # zig-zag of long lines at F600, held and resumed in the middle of the first
+    # one; after the resume the block is replanned over the steps left and must
+    # still report F600 once it cruises again
+    job = 'G21 G90\nG1 F600\n' + ''.join('G1 X%d Y%d\n' % (20 * (i % 2 == 0), 10 + 10 * i)
+                                           for i in range(30))
+    lines, _ = simulate(job, ['-i', '900:?', '-i', '1000:!', '-i', '2000:?',
+                              '-i', '3000:~', '-i', '4000:?'])
+    reports = status_reports(lines)
+    expect([state for state, _ in reports] == ['Run', 'Hold', 'Run'], 'states %s' % reports)
+    before, held, after = [fields for _, fields in reports]
+    expect(before['line'] == after['line'], 'resumed block finished by %s' % after)
+    expect(abs(int(before['F']) - 600) <= 6, 'feed %s before the hold' % before['F'])
+    expect(int(held['F']) == 0, 'feed %s while holding' % held['F'])
+    expect(abs(int(after['F']) - 600) <= 6, 'feed %s after the resume' % after['F'])
+
+
+def step_times(path, axis):
+    """Times in ns of the steps of one axis in a CSV step trace."""
+    with open(path) as f:
+        f.readline()
+        return [int(fields[0]) for fields in (line.split(',') for line in f) if fields[1 + axis] != '0']
+
+
+def override_lowered_late():
+    # two lines along X at F6000, the override drops to 50% just before the first
+    # one ends: it keeps its speed and the second one is entered at the speed it
+    # was planned with, then slows down, no jump in between
+    job = 'G21 G90\nG1 X100 F6000\nG1 X200\n'
+    with tempfile.NamedTemporaryFile(suffix='.csv') as trace:
+        lines, _ = simulate(job, ['-t', trace.name, '-i', b'1280:' + b'\x92' * 5, '-i', '2000:?'])
+        times = step_times(trace.name, 0)
+    rate = lambda step: 60e9 / (times[step] - times[step - 1]) / STEPS_PER_MM_X  # mm/min
+    last = round(100 * STEPS_PER_MM_X) - 1  # last step of the first line
+    expect(abs(rate(last) - 6000) <= 60, 'left the first line at F%.0f' % rate(last))
+    expect(abs(rate(last + 1) - rate(last)) <= 60,
+           'F%.0f into the second line after F%.0f' % (rate(last + 1), rate(last)))
+    reports = status_reports(lines)
+    expect(len(reports) == 1 and abs(int(reports[0][1]['F']) - 3000) <= 30, 'reports %s' % reports)
+
+
+def binary_zero_feed():
+    # a feed frame of 0 is refused and does not take the sequence number, the
+    # resent frame with a real feed then moves at it
+    zero = binary_stream.Encoder()
+    frames = [zero.frame(binary_stream.TYPE_FEED, struct.pack('<BH', 0, 0))]
+    valid = binary_stream.Encoder()
+    frames += valid.encode([(400, 300, 600, 0)])
+    lines, position = simulate(b'G21 G90\n' + b''.join(frames))
+    responses = [l for l in lines if l == 'ok' or l.startswith('Error')]
+    expect(responses == ['ok', 'Error: Binary frame', 'ok', 'ok'], 'responses %s' % responses)
+    expect(position != (0.0, 0.0, 0.0), 'no move after the resent feed frame')
+
+
+TESTS = [arc_without_center, hold_resume_feed, override_lowered_late, binary_zero_feed]
+
+
+def main():
+    subprocess.run(['make', '-s', '-C', motion_check.ROOT, 'ARCH=simulator'], check=True)
+    failed = 0
+    for test in TESTS:
+        try:
+            test()
+            print('%-24s ok' % test.__name__)
+        except AssertionError as e:
+            print('%-24s FAILED: %s' % (test.__name__, e))
+            failed += 1
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
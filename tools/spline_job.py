@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Sample job for the G5 benchmark, see "make splines" in tools/Makefile.
+#
+# Writes the same artwork of cubic Bezier outlines twice: once with G5 as it
+# goes on the wire now and once flattened into G1 lines on the host the way
+# it used to be done, at the spline tolerance from config.h.
+#
+#   python3 tools/spline_job.py splines.gcode lines.gcode
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import os, re, sys, math, random
+
+
+def config_value(name, default):
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'config.h')
+    try:
+        m = re.search(r'#define\s+%s\s+\(?([-0-9.]+)' % name, open(path).read())
+        if m:
+            return float(m.group(1))
+    except IOError:
+        pass
+    return default
+
+
+TOLERANCE = config_value('CONFIG_SPLINE_TOLERANCE', 0.01)
+
+
+def flatten(p0, p1, p2, p3):
+    """End points of the G1 lines for one curve, same flatness test as trace_spline()."""
+    cx, cy = p3[0] - p0[0], p3[1] - p0[1]
+    chord = math.hypot(cx, cy)
+    if chord > TOLERANCE:
+        deviation = max(abs((p[0] - p0[0]) * cy - (p[1] - p0[1]) * cx) / chord for p in (p1, p2))
+    else:
+        deviation = max(math.hypot(p[0] - p0[0], p[1] - p0[1]) for p in (p1, p2))
+    if deviation <= TOLERANCE:
+        return [p3]
+    mid = lambda a, b: ((a[0] + b[0]) / 2, (a[1] + b[1]) / 2)
+    p01, p12, p23 = mid(p0, p1), mid(p1, p2), mid(p2, p3)
+    p012, p123 = mid(p01, p12), mid(p12, p23)
+    m = mid(p012, p123)
+    return flatten(p0, p01, p012, m) + flatten(m, p123, p23, p3)
+
+
+def outlines():
+    """Closed smooth outlines as lists of (start, control 1, control 2, end) curves."""
+    random.seed(1)
+    for row in range(6):
+        for col in range(8):
+            cx, cy = 30 + col * 60, 30 + row * 50
+            n = random.randint(4, 8)
+            points = []
+            for i in range(n):
+                a = 2 * math.pi * i / n
+                r = random.uniform(10, 22)
+                points.append((cx + r * math.cos(a), cy + r * math.sin(a), a))
+            # one tangent length per outline so every joint is a mirror, like G5 without I J
+            k = 0.4 * sum(math.hypot(points[i][0] - points[i - 1][0], points[i][1] - points[i - 1][1])
+                          for i in range(n)) / n
+            curves = []
+            for i in range(n):
+                x0, y0, a0 = points[i]
+                x3, y3, a3 = points[(i + 1) % n]
+                # tangents perpendicular to the radius keep the outline smooth
+                curves.append(((x0, y0), (x0 - k * math.sin(a0), y0 + k * math.cos(a0)),
+                               (x3 + k * math.sin(a3), y3 - k * math.cos(a3)), (x3, y3)))
+            yield curves
+
+
+def write(path, flat):
+    out = open(path, 'w')
+    out.write('G21 G90\nS200 F1200\n')
+    for curves in outlines():
+        out.write('G0 X%.3f Y%.3f\n' % curves[0][0])
+        for i, (p0, p1, p2, p3) in enumerate(curves):
+            if flat:
+                for x, y in flatten(p0, p1, p2, p3):
+                    out.write('G1 X%.3f Y%.3f\n' % (x, y))
+            elif i == 0:
+                out.write('G5 X%.3f Y%.3f I%.3f J%.3f P%.3f Q%.3f\n' % (p3[0], p3[1],
+                          p1[0] - p0[0], p1[1] - p0[1], p2[0] - p3[0], p2[1] - p3[1]))
+            else:
+                # smooth joint, I J is the mirror of the last P Q
+                out.write('G5 X%.3f Y%.3f P%.3f Q%.3f\n' % (p3[0], p3[1],
+                          p2[0] - p3[0], p2[1] - p3[1]))
+    out.close()
+
+
+if __name__ == '__main__':
+    write(sys.argv[1], False)
+    write(sys.argv[2], True)
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+# Velocity and acceleration per axis from a step trace of the simulator.
+#
+#   build/grbl-simulator.elf -t trace.csv job.gcode
+#   python3 tools/step_trace.py trace.csv [curves.csv] [--window 20]
+#
+# The position of each axis, interpolated from step to step, is sampled every
+# --window ms. Its change gives the velocity in mm/s, the change of that the
+# acceleration in mm/s^2. With curves.csv the curves are written out, one line per window:
+#   time_s,vx,vy,vz,ax,ay,az,laser
+# The summary compares the peaks to CONFIG_ACCELERATION and the step timing
+# to the stepper's limits, so a planner or stepper change that overshoots
+# shows up without a logic analyser.
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import os, re, sys, math
+
+
+def config_value(name, default):
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'config.h')
+    try:
+        m = re.search(r'#define\s+%s\s+\(?([-0-9.]+)' % name, open(path).read())
+        if m:
+            return float(m.group(1))
+    except IOError:
+        pass
+    return default
+
+
+AXES = 'xyz'
+STEPS_PER_MM = [config_value('CONFIG_%s_STEPS_PER_MM' % a.upper(), 1.0) for a in AXES]
+ACCELERATION = config_value('CONFIG_ACCELERATION', 1000000.0) / 3600  # mm/s^2
+PULSE_NS = config_value('CONFIG_PULSE_MICROSECONDS', 30) * 1000
+
+
+def read_trace(path):
+    """(time_ns, [x, y, z], laser) per step event."""
+    with open(path) as f:
+        header = f.readline()
+        if not header.startswith('time_ns'):
+            sys.exit('%s: not a CSV step trace (VCD is for a waveform viewer)' % path)
+        for line in f:
+            t, x, y, z, laser = line.split(',')
+            yield int(t), [int(x), int(y), int(z)], int(laser)
+
+
+def positions(events, axis):
+    """(time_ns, position in steps) after each step of one axis."""
+    position = 0
+    for t, step, _ in events:
+        if step[axis]:
+            position += step[axis]
+            yield t, position
+
+
+def sampler(steps):
+    """Position in steps at increasing times, linear from step to step so the
+    low step counts per window do not show up as noise. A run of steps that
+    starts from rest or after a reversal starts one interval before its first
+    step, in between the axis holds its position."""
+    points = []
+    for k, (t, p) in enumerate(steps):
+        direction = p - steps[k - 1][1] if k else 0
+        step = p - (points[-1][1] if points else 0)
+        if k + 1 < len(steps):
+            interval = steps[k + 1][0] - t
+            starts = (k == 0 or step != direction
+                      or t - steps[k - 1][0] > 2 * interval)
+            if starts and steps[k + 1][1] - p == step:
+                points.append((t - interval, p - step))
+        points.append((t, p))
+    k = 0
+    def position(t):
+        nonlocal k
+        if not points or t <= points[0][0]:
+            return float(points[0][1]) if points else 0.0
+        while k + 1 < len(points) and points[k + 1][0] <= t:
+            k += 1
+        t0, p0 = points[k]
+        if k + 1 == len(points):
+            return float(p0)
+        t1, p1 = points[k + 1]
+        return p0 + (p1 - p0) * (t - t0) / (t1 - t0)
+    return position
+
+
+def curves(events, window_ns):
+    """(time_s, velocities, accelerations, laser) per window, mm/s and mm/s^2."""
+    samplers = [sampler(list(positions(events, i))) for i in range(3)]
+    laser = {}    # window -> highest intensity
+    for t, _, intensity in events:
+        w = t // window_ns
+        laser[w] = max(laser.get(w, 0), intensity)
+    window_s = window_ns * 1e-9
+    first, last = events[0][0] // window_ns, events[-1][0] // window_ns
+    previous_position = [s(first * window_ns) for s in samplers]
+    previous_v = [0.0, 0.0, 0.0]
+    for w in range(first, last + 2):  # one past the end to stop
+        position = [s((w + 1) * window_ns) for s in samplers]
+        v = [(position[i] - previous_position[i]) / STEPS_PER_MM[i] / window_s for i in range(3)]
+        a = [(v[i] - previous_v[i]) / window_s for i in range(3)]
+        yield (w + 0.5) * window_s, v, a, laser.get(w, 0)
+        previous_position, previous_v = position, v
+
+
+def main():
+    args = sys.argv[1:]
+    window_ms = 20.0
+    if '--window' in args:
+        i = args.index('--window')
+        window_ms = float(args[i + 1])
+        del args[i:i + 2]
+    if not args:
+        sys.exit(__doc__ or 'usage: step_trace.py trace.csv [curves.csv] [--window ms]')
+
+    events = list(read_trace(args[0]))
+    if not events:
+        sys.exit('%s: no steps' % args[0])
+
+    out = open(args[1], 'w') if len(args) > 1 else None
+    if out:
+        out.write('time_s,vx,vy,vz,ax,ay,az,laser\n')
+    v_peak = [0.0] * 3
+    a_peak = [0.0] * 3
+    a_peak_time = [0.0] * 3
+    for t, v, a, laser in curves(events, int(window_ms * 1e6)):
+        for i in range(3):
+            v_peak[i] = max(v_peak[i], abs(v[i]))
+            if abs(a[i]) > a_peak[i]:
+                a_peak[i], a_peak_time[i] = abs(a[i]), t
+        if out:
+            out.write('%.4f,%s,%s,%d\n' % (t, ','.join('%.3f' % x for x in v),
+                                           ','.join('%.1f' % x for x in a), laser))
+
+    # the shortest interval between steps of one axis, the hardware limit
+    shortest = [None] * 3
+    last = [None] * 3
+    for t, step, _ in events:
+        for i in range(3):
+            if step[i]:
+                if last[i] is not None and (shortest[i] is None or t - last[i] < shortest[i]):
+                    shortest[i] = t - last[i]
+                last[i] = t
+
+    print('%d step events over %.3f s, %g ms windows' % (
+        len(events), (events[-1][0] - events[0][0]) * 1e-9, window_ms))
+    for i, axis in enumerate(AXES):
+        if last[i] is None:
+            continue
+        note = ''
+        if a_peak[i] > 1.5 * ACCELERATION:
+            note = '  (over CONFIG_ACCELERATION %.0f mm/s^2)' % ACCELERATION
+        print('%s: peak %.1f mm/s (%.0f mm/min), peak %.0f mm/s^2 at %.3f s%s' % (
+            axis, v_peak[i], v_peak[i] * 60, a_peak[i], a_peak_time[i], note))
+        if shortest[i] is not None:
+            flag = '  (shorter than the pulse)' if shortest[i] < 2 * PULSE_NS else ''
+            print('   shortest step interval %.1f us%s' % (shortest[i] * 1e-3, flag))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# Line throughput of the simulator while the input comes over a slow wire or
+# a loaded network, on the jobs of motion_check.py.
+#
+#   python3 tools/throughput.py [job.gcode ...]     ("make throughput" in tools/)
+#
+# Every job runs once per link below: the serial port at two baud rates and
+# the telnet stream as segments of a size every period, from a quiet network
+# down to one that lets a few small segments through. Per run it prints the
+# lines per second read while streaming, how much longer the job took than
+# with the input always there, and how often the block buffer ran dry. A
+# link that is fast enough costs no time and starves nothing.
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import os, re, sys, subprocess, tempfile
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, TOOLS)
+import motion_check
+
+# name, simulator options
+LINKS = [('unlimited', []),
+         ('115200 bd', ['-b', '115200']),
+         ('38400 bd', ['-b', '38400']),
+         ('net 1460/1ms', ['-n', '1460/1000']),
+         ('net 536/10ms', ['-n', '536/10000']),
+         ('net 128/10ms', ['-n', '128/10000']),
+         ('net 64/20ms', ['-n', '64/20000'])]
+
+RESULT = re.compile(r'simulated ([0-9.]+) s, .* starved (\d+), (\d+) lines read in ([0-9.]+) s, (\d+) lines/s')
+
+
+def simulate(path, options):
+    """(job seconds, starved, lines, lines/s) of one run."""
+    result = subprocess.run([motion_check.SIMULATOR] + options + [path], stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, universal_newlines=True, check=True)
+    m = RESULT.search(result.stderr)
+    if not m:
+        sys.exit('%s: no result from the simulator\n%s' % (path, result.stderr))
+    return float(m.group(1)), int(m.group(2)), int(m.group(3)), int(m.group(5))
+
+
+def report(name, path):
+    base = None
+    for link, options in LINKS:
+        seconds, starved, lines, rate = simulate(path, options)
+        if base is None:
+            base = seconds
+        print('%-8s %-13s %6d lines %7d lines/s %10.3f s %+7.2f%% starved %d'
+              % (name, link, lines, rate, seconds, 100.0 * (seconds - base) / base, starved))
+
+
+def main(paths):
+    subprocess.run(['make', '-s', '-C', motion_check.ROOT, 'ARCH=simulator'], check=True)
+    if paths:
+        for path in paths:
+            report(os.path.basename(path), path)
+        return
+    with tempfile.TemporaryDirectory() as directory:
+        for name, path in motion_check.corpus(directory):
+            report(name, path)
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+# Turns a dump of the event ring (trace.c) into a timeline.
+#
+#   telnet: trace, trace more, ...   copy the output into a file
+#   simulator: build/grbl-simulator.elf -r events.txt job.gcode
+#
+#   python3 tools/trace_decode.py events.txt [--lanes]
+#
+# Prints every event with its time, the time since the previous one and its
+# argument decoded, then a summary: events per type, the longest times
+# between block starts, how long the stepper stood with an empty buffer
+# and how often the planner or serial buffer ran full. --lanes adds a chart
+# with one row per event type over the dumped time span.
+#
+# Open Source by the terms of the Gnu Public License (GPL3) or higher.
+
+import re, sys
+
+# the numbers of trace.h
+EVENTS = {
+    1: ('line', lambda a: 'status %d' % a if a else 'ok'),
+    2: ('pushed', lambda a: '%d blocks buffered' % a),
+    3: ('full', lambda a: 'planner waits'),
+    4: ('block', lambda a: '%d step events' % a),
+    5: ('rate', lambda a: '%d steps/s' % a),
+    6: ('empty', lambda a: 'stepper out of blocks'),
+    7: ('overrun', lambda a: 'dropped %r' % chr(a & 0xFF)),
+    8: ('frame', lambda a: '%d bytes' % a),
+}
+
+ENTRY = re.compile(r'\b([0-9a-f]{8}) ([0-9a-f]{2}) ([0-9a-f]{4})\b')
+
+
+def read(path):
+    """Clock rate and (seconds, type, arg) of the events, wrap of the timer undone."""
+    hz, ticks, events = None, None, []
+    for line in open(path):
+        m = re.match(r'\s*trace (\d+) Hz', line)
+        if m:
+            hz = int(m.group(1))
+            continue
+        for time, type_, arg in ENTRY.findall(line):
+            t = int(time, 16)
+            if ticks is None:
+                ticks, last = 0, t
+            ticks += (t - last) & 0xFFFFFFFF
+            last = t
+            events.append((ticks, int(type_, 16), int(arg, 16)))
+    if hz is None:
+        sys.exit('%s: no "trace <hz> Hz" header' % path)
+    return [(t / hz, type_, arg) for t, type_, arg in events]
+
+
+def timeline(events):
+    previous = events[0][0] if events else 0
+    print('%12s %10s  %-8s %s' % ('ms', '+us', 'event', ''))
+    for t, type_, arg in events:
+        name, detail = EVENTS.get(type_, ('type %d' % type_, lambda a: '%d' % a))
+        print('%12.3f %10.1f  %-8s %s' % ((t - events[0][0]) * 1e3, (t - previous) * 1e6, name, detail(arg)))
+        previous = t
+
+
+def summary(events):
+    counts = {}
+    for _, type_, _ in events:
+        counts[type_] = counts.get(type_, 0) + 1
+    span = events[-1][0] - events[0][0]
+    print('\n%d events over %.3f ms: %s' % (len(events), span * 1e3, ', '.join(
+        '%d %s' % (n, EVENTS.get(k, ('type %d' % k,))[0]) for k, n in sorted(counts.items()))))
+
+    starts = [t for t, type_, _ in events if type_ == 4]
+    gaps = sorted(((b - a, a) for a, b in zip(starts, starts[1:])), reverse=True)[:5]
+    if gaps:
+        print('longest between block starts: %s' % ', '.join(
+            '%.2f ms at %.3f ms' % (g * 1e3, (t - events[0][0]) * 1e3) for g, t in gaps))
+
+    idle, resumed, empty_since = 0.0, 0, None
+    for t, type_, _ in events:
+        if type_ == 6 and empty_since is None:
+            empty_since = t
+        elif type_ == 4 and empty_since is not None:
+            idle += t - empty_since
+            resumed += 1
+            empty_since = None
+    if counts.get(6):
+        print('stepper ran out of blocks %d times, %d times the job went on after %.2f ms in total' % (
+            counts[6], resumed, idle * 1e3))
+    if counts.get(3):
+        print('planner buffer full %d times' % counts[3])
+    if counts.get(7):
+        print('serial receive buffer overran %d times' % counts[7])
+
+
+def lanes(events, width=72):
+    start, span = events[0][0], (events[-1][0] - events[0][0]) or 1e-9
+    print('\n%-8s|%s| %.3f ms' % ('', '-' * width, span * 1e3))
+    for type_ in sorted(set(e[1] for e in events)):
+        row = [' '] * width
+        for t, k, _ in events:
+            if k == type_:
+                row[min(width - 1, int((t - start) / span * width))] = '|'
+        print('%-8s|%s|' % (EVENTS.get(type_, ('type %d' % type_,))[0], ''.join(row)))
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith('--')]
+    if len(args) != 1:
+        sys.exit('usage: trace_decode.py events.txt [--lanes]')
+    events = read(args[0])
+    if not events:
+        sys.exit('%s: no events' % args[0])
+    timeline(events)
+    summary(events)
+    if '--lanes' in sys.argv:
+        lanes(events)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,63 @@
+/*
+  trace.c - ring of timestamped binary events for post-mortem debugging
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+/* Recording an event takes a timestamp and an 8 byte store with the interrupts
+   off for a moment, unlike printString() it does not change the timing it is
+   meant to show. The ring keeps the last TRACE_SIZE events. The shell's trace
+   command (or the simulator's -r) freezes it and dumps it, to be turned into
+   a timeline by tools/trace_decode.py. A freeze that is not ended within
+   TRACE_FREEZE_SECONDS ends by itself. */
+
+#include "dev_misc.h"
+#include "trace.h"
+
+static trace_entry_t trace_ring[TRACE_SIZE];
+static volatile uint32_t trace_total;   // events recorded so far, the next index
+static volatile bool trace_frozen;      // being read out
+static uint32_t frozen_at;              // dev_timestamp() of the freeze
+
+
+void trace_event(uint8_t type, uint16_t arg) {
+  trace_entry_t *entry;
+  uint32_t flags;
+  if (trace_frozen) {
+    // a dump that is never read to the end must not stop the recording for good
+    if (dev_timestamp() - frozen_at < (uint32_t)TRACE_FREEZE_SECONDS*DEV_TIMESTAMP_HZ) { return; }
+    trace_frozen = false;
+  }
+  flags = dev_irq_save();
+  entry = &trace_ring[trace_total++ & (TRACE_SIZE-1)];
+  entry->time = dev_timestamp();
+  entry->type = type;
+  entry->arg = arg;
+  dev_irq_restore(flags);
+}
+
+void trace_freeze(bool frozen) {
+  frozen_at = dev_timestamp();
+  trace_frozen = frozen;
+}
+
+bool trace_is_frozen() {
+  return trace_frozen;
+}
+
+uint16_t trace_count() {
+  return trace_total > TRACE_SIZE ? TRACE_SIZE : trace_total;
+}
+
+trace_entry_t trace_get(uint16_t index) {
+  return trace_ring[(trace_total - trace_count() + index) & (TRACE_SIZE-1)];
+}
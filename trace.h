@@ -0,0 +1,55 @@
+/*
+  trace.h - ring of timestamped binary events for post-mortem debugging
+  Part of LasaurGrbl
+
+  LasaurGrbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LasaurGrbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+*/
+
+#ifndef trace_h
+#define trace_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRACE_SIZE 256  // entries, a power of 2
+#define TRACE_FREEZE_SECONDS 30  // a freeze not ended by then ends with the next event
+
+// event types, tools/trace_decode.py knows them by these numbers
+#define TRACE_LINE_DONE      1  // parser answered a line, arg: status code
+#define TRACE_BLOCK_PUSHED   2  // planner, arg: blocks buffered
+#define TRACE_BUFFER_FULL    3  // planner waits for a free block
+#define TRACE_BLOCK_STARTED  4  // stepper, arg: step events of the block, saturated
+#define TRACE_RATE_CHANGE    5  // stepper, arg: steps per second, saturated
+#define TRACE_BUFFER_EMPTY   6  // stepper ran out of blocks while running
+#define TRACE_BYTE_OVERRUN   7  // serial receive buffer full, arg: the dropped byte
+#define TRACE_NET_FRAME      8  // network frame received, arg: length
+
+typedef struct {
+  uint32_t time;     // dev_timestamp(), its rate depends on the arch
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t arg;
+} trace_entry_t;
+
+// record an event, from tasks and interrupts alike
+void trace_event(uint8_t type, uint16_t arg);
+
+// stop recording to read the ring out, and continue
+void trace_freeze(bool frozen);
+
+// false once a freeze ended, also by TRACE_FREEZE_SECONDS
+bool trace_is_frozen();
+
+// the events held, and the one at index, 0 the oldest
+uint16_t trace_count();
+trace_entry_t trace_get(uint16_t index);
+
+#endif